@@ -0,0 +1,539 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+
+// Benchmarks for scanning libraries and querying the registry.
+// The command line flags and the json output follow Google Benchmark, so its tools (e.g. compare.py) can be used to track regressions:
+//   extension_system_bench --benchmark_format=json --benchmark_filter=searchDirectory --benchmark_min_time=0.5
+// The benchmark has to be started within the build directory, createExtension uses libextension_system_test_lib.
+// --benchmark_corpus=<dir> adds benchmarks using a corpus generated by benchmark/corpus/CMakeLists.txt.
+
+#include "../test/Interfaces.hpp"
+#include <extension_system/ExtensionSystem.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <memory>
+#include <regex>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace extension_system;
+
+namespace {
+
+class State final {
+public:
+    explicit State(std::uint64_t iterations)
+        : m_iterations{iterations} {}
+
+    bool keepRunning() {
+        if (m_done == 0 && !m_running)
+            resumeTiming();
+        if (m_done < m_iterations) {
+            ++m_done;
+            return true;
+        }
+        pauseTiming();
+        return false;
+    }
+
+    void pauseTiming() {
+        if (!m_running)
+            return;
+        m_real += std::chrono::steady_clock::now() - m_real_start;
+        m_cpu += std::clock() - m_cpu_start;
+        m_running = false;
+    }
+
+    void resumeTiming() {
+        m_running    = true;
+        m_cpu_start  = std::clock();
+        m_real_start = std::chrono::steady_clock::now();
+    }
+
+    void setBytesProcessed(std::uint64_t bytes) {
+        m_bytes = bytes;
+    }
+
+    void setItemsProcessed(std::uint64_t items) {
+        m_items = items;
+    }
+
+    std::uint64_t iterations() const {
+        return m_iterations;
+    }
+
+    double realSeconds() const {
+        return std::chrono::duration<double>(m_real).count();
+    }
+
+    double cpuSeconds() const {
+        return static_cast<double>(m_cpu) / CLOCKS_PER_SEC;
+    }
+
+    std::uint64_t bytesProcessed() const {
+        return m_bytes;
+    }
+
+    std::uint64_t itemsProcessed() const {
+        return m_items;
+    }
+
+private:
+    std::uint64_t                         m_iterations;
+    std::uint64_t                         m_done    = 0;
+    bool                                  m_running = false;
+    std::chrono::steady_clock::duration   m_real{};
+    std::chrono::steady_clock::time_point m_real_start;
+    std::clock_t                          m_cpu       = 0;
+    std::clock_t                          m_cpu_start = 0;
+    std::uint64_t                         m_bytes     = 0;
+    std::uint64_t                         m_items     = 0;
+};
+
+// data shared by benchmarks, created on first use so only the fixtures of the selected benchmarks are built
+class Fixture final {
+public:
+    explicit Fixture(std::function<std::shared_ptr<void>()> create)
+        : m_create{std::move(create)} {}
+
+    template <typename T>
+    T& get() {
+        if (m_value == nullptr)
+            m_value = m_create();
+        return *static_cast<T*>(m_value.get());
+    }
+
+    void release() {
+        m_value.reset();
+    }
+
+private:
+    std::function<std::shared_ptr<void>()> m_create;
+    std::shared_ptr<void>                  m_value;
+};
+
+template <typename T>
+std::shared_ptr<Fixture> makeFixture(std::function<std::shared_ptr<T>()> create) {
+    return std::make_shared<Fixture>([create]() -> std::shared_ptr<void> { return create(); });
+}
+
+struct Benchmark final {
+    std::string                 name;
+    std::function<void(State&)> func;
+    std::shared_ptr<Fixture>    fixture; // may be null
+};
+
+template <typename T>
+void add(std::vector<Benchmark>& benchmarks, const std::string& name, const std::shared_ptr<Fixture>& fixture,
+         const std::function<void(State&, T&)>& func) {
+    benchmarks.push_back({name, [fixture, func](State& state) { func(state, fixture->get<T>()); }, fixture});
+}
+
+struct Result final {
+    std::string   name;
+    std::uint64_t iterations;
+    double        real_time; // ns per iteration
+    double        cpu_time;  // ns per iteration
+    double        bytes_per_second;
+    double        items_per_second;
+};
+
+Result run(const Benchmark& benchmark, double min_time) {
+    std::uint64_t iterations = 1;
+    for (;;) {
+        State state{iterations};
+        benchmark.func(state);
+
+        const auto seconds = state.realSeconds();
+        if (seconds >= min_time || iterations >= 1000000000) {
+            const auto n = static_cast<double>(iterations);
+            return {benchmark.name,
+                    iterations,
+                    seconds * 1e9 / n,
+                    state.cpuSeconds() * 1e9 / n,
+                    seconds > 0 ? static_cast<double>(state.bytesProcessed()) / seconds : 0,
+                    seconds > 0 ? static_cast<double>(state.itemsProcessed()) / seconds : 0};
+        }
+
+        // same heuristic as Google Benchmark: aim for 1.4 times the minimal time, grow at most by factor 10
+        const double multiplier = seconds <= 0 ? 10 : std::min(10.0, std::max(1.4 * min_time / seconds, 1.1));
+        iterations              = static_cast<std::uint64_t>(static_cast<double>(iterations) * multiplier) + 1;
+    }
+}
+
+std::string jsonEscape(const std::string& str) {
+    std::string result;
+    for (const char c : str) {
+        if (c == '"' || c == '\\')
+            result += '\\';
+        result += c;
+    }
+    return result;
+}
+
+// The marker strings are concatenated at runtime, see ExtensionSystem::desc_start, the entries use the text encoding
+std::string makeDescription(const std::string& interface_name, const std::string& name, unsigned version, std::size_t user_entries) {
+    const std::string base = "EXTENSION_SYSTEM_METADATA_DESCRIPTION_";
+    std::string       result;
+    const auto        entry = [&](const std::string& key, const std::string& value) {
+        result += key;
+        result += '=';
+        result += value;
+        result += '\0';
+    };
+
+    entry(base + "START", EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_TEXT);
+    entry("compiler", EXTENSION_SYSTEM_COMPILER);
+    entry("compiler_version", EXTENSION_SYSTEM_COMPILER_VERSION_STR);
+    entry("build_type", EXTENSION_SYSTEM_BUILD_TYPE);
+    entry("interface_name", interface_name);
+    entry("name", name);
+    entry("version", std::to_string(version));
+    entry("description", "synthetic extension " + name);
+    entry("entry_point", "entry_point_" + name + "_" + std::to_string(version));
+    for (std::size_t i = 0; i < user_entries; ++i)
+        entry("user_key" + std::to_string(i), "user value " + std::to_string(i));
+    result += base + "END";
+    return result;
+}
+
+// the start of a real library, searchDirectory skips files without a valid header (DynamicLibrary::checkFileFormat)
+const std::string& libraryHeader() {
+    static const std::string header = [] {
+        std::ifstream in{"libextension_system_test_lib" + DynamicLibrary::fileExtension(), std::ios::binary};
+        std::string   result(4096, '\0');
+        in.read(&result[0], static_cast<std::streamsize>(result.size()));
+        result.resize(static_cast<std::size_t>(in.gcount()));
+        return result;
+    }();
+    return header;
+}
+
+// library header and pseudo random content that doesn't contain the markers, followed by the descriptions
+void writeLibrary(const std::filesystem::path& p, std::size_t size, const std::vector<std::string>& descriptions) {
+    std::string content;
+    for (const auto& d : descriptions)
+        content += d;
+
+    const auto&   header = libraryHeader();
+    std::string   padding(size > content.size() + header.size() ? size - content.size() - header.size() : 0, '\0');
+    std::uint32_t x = 2463534242U;
+    for (auto& c : padding) {
+        x ^= x << 13U;
+        x ^= x >> 17U;
+        x ^= x << 5U;
+        c = static_cast<char>(x & 0xffU);
+    }
+
+    std::ofstream out{p, std::ios::binary};
+    out << header << padding << content;
+}
+
+class TemporaryDirectory final {
+public:
+    explicit TemporaryDirectory(const std::string& name) {
+        m_path = std::filesystem::temp_directory_path()
+                 / ("extension_system_bench_" + name + "_" + std::to_string(std::chrono::steady_clock::now().time_since_epoch().count()));
+        std::filesystem::create_directories(m_path);
+    }
+    TemporaryDirectory(TemporaryDirectory&&)      = delete;
+    TemporaryDirectory(const TemporaryDirectory&) = delete;
+    TemporaryDirectory& operator=(TemporaryDirectory&&) = delete;
+    TemporaryDirectory& operator=(const TemporaryDirectory&) = delete;
+
+    ~TemporaryDirectory() noexcept {
+        std::error_code ec;
+        std::filesystem::remove_all(m_path, ec);
+    }
+
+    const std::filesystem::path& path() const {
+        return m_path;
+    }
+
+private:
+    std::filesystem::path m_path;
+};
+
+void silence(ExtensionSystem& extension_system) {
+    extension_system.setMessageHandler(nullptr);
+}
+
+std::vector<Benchmark> registerBenchmarks() {
+    std::vector<Benchmark> benchmarks;
+    const auto             ext = DynamicLibrary::fileExtension();
+
+    // addDynamicLibrary scans the whole file, report the throughput
+    for (const std::size_t size : {64U << 10U, 1U << 20U, 16U << 20U, 64U << 20U}) {
+        const auto file    = "scan_" + std::to_string(size) + ext;
+        const auto fixture = makeFixture<TemporaryDirectory>([file, size] {
+            auto tmp = std::make_shared<TemporaryDirectory>("scan");
+            writeLibrary(tmp->path() / file, size, {makeDescription("IBench", "scan", 1, 4)});
+            return tmp;
+        });
+        add<TemporaryDirectory>(
+            benchmarks, "BM_addDynamicLibrary/" + std::to_string(size), fixture, [file, size](State& state, TemporaryDirectory& tmp) {
+                const auto path = (tmp.path() / file).string();
+                while (state.keepRunning()) {
+                    state.pauseTiming();
+                    ExtensionSystem extension_system;
+                    silence(extension_system);
+                    state.resumeTiming();
+                    if (extension_system.addDynamicLibrary(path) != 1)
+                        std::abort();
+                }
+                state.setBytesProcessed(state.iterations() * size);
+            });
+    }
+
+    // directory trees, every 10th file contains an extension
+    for (const std::size_t count : {10U, 1000U, 10000U}) {
+        const auto fixture = makeFixture<TemporaryDirectory>([count, ext] {
+            auto tmp = std::make_shared<TemporaryDirectory>("tree");
+            for (std::size_t i = 0; i < count; ++i) {
+                const auto sub = tmp->path() / ("dir" + std::to_string(i / 100));
+                std::filesystem::create_directories(sub);
+                std::vector<std::string> desc;
+                if (i % 10 == 0)
+                    desc.push_back(makeDescription("IBench", "tree" + std::to_string(i), 1, 2));
+                writeLibrary(sub / ("lib" + std::to_string(i) + ext), 4096, desc);
+            }
+            return tmp;
+        });
+        add<TemporaryDirectory>(
+            benchmarks, "BM_searchDirectory/" + std::to_string(count), fixture, [count](State& state, TemporaryDirectory& tmp) {
+                while (state.keepRunning()) {
+                    state.pauseTiming();
+                    ExtensionSystem extension_system;
+                    silence(extension_system);
+                    state.resumeTiming();
+                    extension_system.searchDirectory(tmp.path().string(), true);
+                }
+                state.setItemsProcessed(state.iterations() * count);
+            });
+    }
+
+    // registries with count extensions spread over 10 interfaces, 10 versions per extension and 100 libraries,
+    // the libraries are deleted once they are scanned
+    for (const std::size_t count : {100U, 10000U}) {
+        const auto fixture = makeFixture<ExtensionSystem>([count, ext] {
+            const TemporaryDirectory tmp{"registry"};
+            for (std::size_t lib = 0; lib < 100; ++lib) {
+                std::vector<std::string> desc;
+                for (std::size_t i = lib; i < count; i += 100)
+                    desc.push_back(makeDescription(
+                        "IBench" + std::to_string(i % 10), "ext" + std::to_string(i / 100), static_cast<unsigned>((i / 10) % 10 + 1), 4));
+                writeLibrary(tmp.path() / ("lib" + std::to_string(lib) + ext), 0, desc);
+            }
+
+            auto extension_system = std::make_shared<ExtensionSystem>();
+            silence(*extension_system);
+            extension_system->searchDirectory(tmp.path().string());
+            return extension_system;
+        });
+
+        const auto name   = "ext" + std::to_string(count / 200);
+        const auto prefix = "BM_extensionsFilter/" + std::to_string(count);
+        add<ExtensionSystem>(benchmarks, prefix, fixture, [](State& state, ExtensionSystem& extension_system) {
+            std::size_t found = 0;
+            while (state.keepRunning())
+                found += extension_system.extensions({{"interface_name", "IBench3"}, {"user_key1", "user value 1"}}).size();
+            if (found == 0)
+                std::abort();
+            state.setItemsProcessed(state.iterations());
+        });
+
+        // only indexed keys, all versions of an extension
+        add<ExtensionSystem>(benchmarks, prefix + "/name", fixture, [name](State& state, ExtensionSystem& extension_system) {
+            while (state.keepRunning())
+                if (extension_system.extensions({{"interface_name", "IBench0"}, {"name", name}}).empty())
+                    std::abort();
+            state.setItemsProcessed(state.iterations());
+        });
+
+        add<ExtensionSystem>(benchmarks, prefix + "/version", fixture, [name](State& state, ExtensionSystem& extension_system) {
+            while (state.keepRunning())
+                if (extension_system.extensions({{"interface_name", "IBench0"}, {"name", name}, {"version", "1"}}).empty())
+                    std::abort();
+            state.setItemsProcessed(state.iterations());
+        });
+    }
+
+    // cold: the library is loaded and unloaded for every extension, warm: the library stays loaded
+    for (const auto policy : {UnloadPolicy::Immediate, UnloadPolicy::Never}) {
+        const std::string name = policy == UnloadPolicy::Immediate ? "cold" : "warm";
+        benchmarks.push_back({"BM_createExtension/" + name, [policy](State& state) {
+                                  ExtensionSystem extension_system;
+                                  silence(extension_system);
+                                  extension_system.setUnloadPolicy(policy);
+                                  extension_system.addDynamicLibrary("libextension_system_test_lib" + DynamicLibrary::fileExtension());
+                                  while (state.keepRunning()) {
+                                      auto e = extension_system.createExtension<IExt1>("Ext1");
+                                      if (e == nullptr)
+                                          std::abort();
+                                  }
+                                  state.setItemsProcessed(state.iterations());
+                              },
+                              nullptr});
+    }
+
+    // the lookup of a given version or the highest version within a range, the library stays loaded
+    const std::function<std::shared_ptr<IExt1>(ExtensionSystem&)> lookups[] = {
+        [](ExtensionSystem& extension_system) { return extension_system.createExtension<IExt1>("Ext1", 100); },
+        [](ExtensionSystem& extension_system) { return extension_system.createExtension<IExt1>("Ext1", VersionRange{">=1 <1.1"}); }};
+    for (std::size_t i = 0; i < 2; ++i) {
+        const auto lookup = lookups[i];
+        benchmarks.push_back({std::string{"BM_createExtension/warm/"} + (i == 0 ? "version" : "range"), [lookup](State& state) {
+                                  ExtensionSystem extension_system;
+                                  silence(extension_system);
+                                  extension_system.setUnloadPolicy(UnloadPolicy::Never);
+                                  extension_system.addDynamicLibrary("libextension_system_test_lib" + DynamicLibrary::fileExtension());
+                                  while (state.keepRunning())
+                                      if (lookup(extension_system) == nullptr)
+                                          std::abort();
+                                  state.setItemsProcessed(state.iterations());
+                              },
+                              nullptr});
+    }
+
+    return benchmarks;
+}
+
+std::vector<Benchmark> registerCorpusBenchmarks(const std::string& corpus) {
+    std::vector<Benchmark> benchmarks;
+
+    benchmarks.push_back({"BM_corpus/searchDirectory", [corpus](State& state) {
+                              std::size_t found = 0;
+                              while (state.keepRunning()) {
+                                  state.pauseTiming();
+                                  ExtensionSystem extension_system;
+                                  silence(extension_system);
+                                  state.resumeTiming();
+                                  extension_system.searchDirectory(corpus, true);
+                                  state.pauseTiming();
+                                  found += extension_system.extensions().size();
+                                  state.resumeTiming();
+                              }
+                              state.setItemsProcessed(found);
+                          },
+                          nullptr});
+
+    const auto fixture = makeFixture<ExtensionSystem>([corpus] {
+        auto extension_system = std::make_shared<ExtensionSystem>();
+        silence(*extension_system);
+        extension_system->searchDirectory(corpus, true);
+        return extension_system;
+    });
+
+    add<ExtensionSystem>(benchmarks, "BM_corpus/extensionsFilter", fixture, [](State& state, ExtensionSystem& extension_system) {
+        while (state.keepRunning())
+            (void)extension_system.extensions({{"interface_name", "corpus::Interface1"}, {"key0", "value 1 0 0"}});
+        state.setItemsProcessed(state.iterations());
+    });
+
+    add<ExtensionSystem>(benchmarks, "BM_corpus/extensionsFilter/name", fixture, [](State& state, ExtensionSystem& extension_system) {
+        while (state.keepRunning())
+            (void)extension_system.extensions({{"interface_name", "corpus::Interface1"}, {"name", "extension1"}});
+        state.setItemsProcessed(state.iterations());
+    });
+
+    return benchmarks;
+}
+
+} // namespace
+
+int main(int argc, char** argv) try {
+    std::string format   = "console";
+    std::regex  filter{".*"};
+    double      min_time = 0.5;
+    std::string corpus;
+
+    for (int i = 1; i < argc; ++i) {
+        const std::string arg{argv[i]}; // NOLINT
+        const auto        value = [&](const std::string& flag) { return arg.compare(0, flag.size(), flag) == 0 ? arg.substr(flag.size()) : std::string{}; };
+
+        if (!value("--benchmark_format=").empty()) {
+            format = value("--benchmark_format=");
+        } else if (!value("--benchmark_filter=").empty()) {
+            filter = std::regex{value("--benchmark_filter=")};
+        } else if (!value("--benchmark_min_time=").empty()) {
+            min_time = std::stod(value("--benchmark_min_time="));
+        } else if (!value("--benchmark_corpus=").empty()) {
+            corpus = value("--benchmark_corpus=");
+        } else {
+            std::cerr << "usage: " << argv[0] // NOLINT
+                      << " [--benchmark_format=console|json] [--benchmark_filter=<regex>] [--benchmark_min_time=<seconds>]"
+                         " [--benchmark_corpus=<dir>]\n";
+            return -1;
+        }
+    }
+
+    std::vector<Result> results;
+
+    auto benchmarks = registerBenchmarks();
+    if (!corpus.empty()) {
+        const auto corpus_benchmarks = registerCorpusBenchmarks(corpus);
+        benchmarks.insert(benchmarks.end(), corpus_benchmarks.begin(), corpus_benchmarks.end());
+    }
+    const auto unselected = [&](const Benchmark& b) { return !std::regex_search(b.name, filter); };
+    benchmarks.erase(std::remove_if(benchmarks.begin(), benchmarks.end(), unselected), benchmarks.end());
+
+    for (auto benchmark = benchmarks.begin(); benchmark != benchmarks.end(); ++benchmark) {
+        results.push_back(run(*benchmark, min_time));
+
+        // free the fixture, e.g. delete its files, once no following benchmark uses it
+        if (benchmark->fixture != nullptr
+            && std::none_of(benchmark + 1, benchmarks.end(), [&](const Benchmark& b) { return b.fixture == benchmark->fixture; }))
+            benchmark->fixture->release();
+
+        const auto& r = results.back();
+        if (format == "console") {
+            std::printf("%-40s %15.0f ns %15.0f ns %12llu", r.name.c_str(), r.real_time, r.cpu_time, static_cast<unsigned long long>(r.iterations));
+            if (r.bytes_per_second > 0)
+                std::printf(" %10.2f MB/s", r.bytes_per_second / 1e6);
+            if (r.items_per_second > 0)
+                std::printf(" %12.0f items/s", r.items_per_second);
+            std::printf("\n");
+            std::fflush(stdout);
+        }
+    }
+
+    if (format == "json") {
+        std::cout << "{\n  \"context\": {\n"
+                  << "    \"executable\": \"" << jsonEscape(argv[0]) << "\",\n" // NOLINT
+                  << "    \"num_cpus\": " << std::thread::hardware_concurrency() << ",\n"
+                  << "    \"library_build_type\": \"" << EXTENSION_SYSTEM_BUILD_TYPE << "\",\n"
+                  << "    \"compiler\": \"" << jsonEscape(EXTENSION_SYSTEM_COMPILER " " EXTENSION_SYSTEM_COMPILER_VERSION_STR) << "\"\n"
+                  << "  },\n  \"benchmarks\": [\n";
+        for (std::size_t i = 0; i < results.size(); ++i) {
+            const auto& r = results[i];
+            std::cout << "    {\n"
+                      << "      \"name\": \"" << jsonEscape(r.name) << "\",\n"
+                      << "      \"run_name\": \"" << jsonEscape(r.name) << "\",\n"
+                      << "      \"run_type\": \"iteration\",\n"
+                      << "      \"iterations\": " << r.iterations << ",\n"
+                      << "      \"real_time\": " << r.real_time << ",\n"
+                      << "      \"cpu_time\": " << r.cpu_time << ",\n"
+                      << "      \"time_unit\": \"ns\"";
+            if (r.bytes_per_second > 0)
+                std::cout << ",\n      \"bytes_per_second\": " << r.bytes_per_second;
+            if (r.items_per_second > 0)
+                std::cout << ",\n      \"items_per_second\": " << r.items_per_second;
+            std::cout << "\n    }" << (i + 1 < results.size() ? "," : "") << "\n";
+        }
+        std::cout << "  ]\n}\n";
+    }
+
+    return 0;
+} catch (const std::exception& e) {
+    std::cerr << "Caught exception " << e.what() << "\n";
+    return -1;
+}
@@ -0,0 +1,90 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace extension_system {
+
+/**
+ * Monotonic allocator, memory is only released when the arena is destroyed.
+ * Only trivially destructible objects can be allocated, their destructors are never called.
+ * not thread-safe, but objects stored in the arena can be read from multiple threads
+ */
+class Arena final {
+public:
+    explicit Arena(std::size_t initial_block_size = 1024)
+        : m_next_block_size{initial_block_size} {}
+    Arena(Arena&&)      = delete;
+    Arena(const Arena&) = delete;
+    Arena& operator=(Arena&&) = delete;
+    Arena& operator=(const Arena&) = delete;
+    ~Arena() noexcept              = default;
+
+    void* allocate(std::size_t size, std::size_t alignment) {
+        auto padding = static_cast<std::size_t>(-reinterpret_cast<std::uintptr_t>(m_current)) & (alignment - 1);
+        if (m_current == nullptr || padding + size > m_remaining) {
+            addBlock(size + alignment);
+            padding = static_cast<std::size_t>(-reinterpret_cast<std::uintptr_t>(m_current)) & (alignment - 1);
+        }
+
+        void* result = m_current + padding;
+        m_current += padding + size;
+        m_remaining -= padding + size;
+        m_used += padding + size;
+        return result;
+    }
+
+    template <typename T>
+    T* allocateArray(std::size_t count) {
+        static_assert(std::is_trivially_destructible<T>::value, "destructors of objects in the arena are never called");
+        return static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+    }
+
+    /// @returns a null-terminated copy of [str, str+size)
+    const char* copyString(const char* str, std::size_t size) {
+        auto* result = static_cast<char*>(allocate(size + 1, 1));
+        if (size != 0)
+            std::memcpy(result, str, size);
+        result[size] = '\0';
+        return result;
+    }
+
+    /// @returns the number of bytes allocated from the system
+    std::size_t reserved() const {
+        return m_reserved;
+    }
+
+    /// @returns the number of bytes handed out including alignment padding
+    std::size_t used() const {
+        return m_used;
+    }
+
+private:
+    void addBlock(std::size_t min_size) {
+        // large objects get their own block, small ones share blocks that grow up to 64 KiB
+        const std::size_t max_block_size = 64 * 1024;
+        const std::size_t size           = min_size > m_next_block_size ? min_size : m_next_block_size;
+        if (m_next_block_size < max_block_size)
+            m_next_block_size *= 2;
+
+        m_blocks.emplace_back(new char[size]);
+        m_current   = m_blocks.back().get();
+        m_remaining = size;
+        m_reserved += size;
+    }
+
+    std::vector<std::unique_ptr<char[]>> m_blocks;
+    char*                                m_current{};
+    std::size_t                          m_remaining{};
+    std::size_t                          m_next_block_size;
+    std::size_t                          m_reserved{};
+    std::size_t                          m_used{};
+};
+}
@@ -0,0 +1,158 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#include "DirectoryFilter.hpp"
+
+#include "DynamicLibrary.hpp"
+#include <algorithm>
+#include <cstring>
+
+using namespace extension_system;
+
+namespace {
+/**
+ * Matches c against the pattern element at p (a character, '?', a character class or an escaped character)
+ * p is moved behind the element
+ */
+bool matchElement(const char*& p, const char* p_end, char c) {
+    if (*p == '?') {
+        ++p;
+        return true;
+    }
+
+    if (*p == '[') {
+        const char* q      = p + 1;
+        const bool  negate = q != p_end && (*q == '!' || *q == '^');
+        if (negate)
+            ++q;
+
+        bool matched = false;
+        // a ']' directly after the opening bracket is part of the class
+        for (bool first = true; q != p_end && (first || *q != ']'); first = false) {
+            const char low = *q++;
+            if (q + 1 < p_end && *q == '-' && q[1] != ']') {
+                const char high = q[1];
+                q += 2;
+                matched = matched || (low <= c && c <= high);
+            } else {
+                matched = matched || low == c;
+            }
+        }
+
+        if (q != p_end) {
+            p = q + 1; // behind ']'
+            return matched != negate;
+        }
+        // without closing bracket '[' is an ordinary character
+    } else if (*p == '\\' && p + 1 != p_end) {
+        ++p;
+    }
+
+    return *p++ == c;
+}
+
+bool matchGlob(const std::string& pattern, const char* name, std::size_t length) {
+    const char* p     = pattern.c_str();
+    const char* p_end = p + pattern.length();
+    const char* n     = name;
+    const char* n_end = name + length;
+
+    // position behind the last '*' and the name position it currently matches up to, only the last '*' has to be backtracked
+    const char* star_p = nullptr;
+    const char* star_n = nullptr;
+
+    while (n != n_end) {
+        if (p != p_end && *p == '*') {
+            star_p = ++p;
+            star_n = n;
+            continue;
+        }
+
+        const char* next = p;
+        if (p != p_end && matchElement(next, p_end, *n)) {
+            p = next;
+            ++n;
+            continue;
+        }
+
+        if (star_p == nullptr)
+            return false;
+        p = star_p;
+        n = ++star_n;
+    }
+
+    while (p != p_end && *p == '*')
+        ++p;
+    return p == p_end;
+}
+
+bool matchAny(const std::vector<std::string>& patterns, const std::vector<std::regex>& expressions, const char* name, std::size_t length) {
+    return std::any_of(patterns.begin(), patterns.end(), [&](const std::string& p) { return matchGlob(p, name, length); })
+           || std::any_of(expressions.begin(), expressions.end(), [&](const std::regex& e) { return std::regex_match(name, name + length, e); });
+}
+} // namespace
+
+DirectoryFilter& DirectoryFilter::include(const std::string& pattern) {
+    m_include_patterns.push_back(pattern);
+    return *this;
+}
+
+DirectoryFilter& DirectoryFilter::includeRegex(const std::string& expression) {
+    m_include_expressions.emplace_back(expression, std::regex::ECMAScript | std::regex::optimize);
+    return *this;
+}
+
+DirectoryFilter& DirectoryFilter::exclude(const std::string& pattern) {
+    m_exclude_patterns.push_back(pattern);
+    return *this;
+}
+
+DirectoryFilter& DirectoryFilter::excludeRegex(const std::string& expression) {
+    m_exclude_expressions.emplace_back(expression, std::regex::ECMAScript | std::regex::optimize);
+    return *this;
+}
+
+DirectoryFilter& DirectoryFilter::maxDepth(std::size_t depth) {
+    m_max_depth = depth;
+    return *this;
+}
+
+bool DirectoryFilter::excluded(const char* name, std::size_t length) const {
+    return matchAny(m_exclude_patterns, m_exclude_expressions, name, length);
+}
+
+bool DirectoryFilter::matchesFile(const char* name, std::size_t length) const {
+    if (excluded(name, length))
+        return false;
+
+    if (m_include_patterns.empty() && m_include_expressions.empty()) {
+        static const std::string extension = DynamicLibrary::fileExtension();
+        return length >= extension.length() && std::memcmp(name + length - extension.length(), extension.data(), extension.length()) == 0;
+    }
+
+    return matchAny(m_include_patterns, m_include_expressions, name, length);
+}
+
+bool DirectoryFilter::matchesDirectory(const char* name, std::size_t length) const {
+    return !excluded(name, length);
+}
+
+bool DirectoryFilter::matchesPath(const std::string& relative_path) const {
+#ifdef _WIN32
+    const char* separators = "/\\";
+#else
+    const char* separators = "/";
+#endif
+
+    std::size_t depth = 0;
+    std::size_t begin = relative_path.find_first_not_of(separators);
+    while (begin != std::string::npos) {
+        const auto end = relative_path.find_first_of(separators, begin);
+        if (end == std::string::npos)
+            return matchesFile(relative_path.c_str() + begin, relative_path.length() - begin);
+
+        if (++depth > m_max_depth || !matchesDirectory(relative_path.c_str() + begin, end - begin))
+            return false;
+        begin = relative_path.find_first_not_of(separators, end);
+    }
+    return false;
+}
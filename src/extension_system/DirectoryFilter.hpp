@@ -0,0 +1,76 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <cstddef>
+#include <regex>
+#include <string>
+#include <vector>
+
+namespace extension_system {
+
+/**
+ * Selects the files ExtensionSystem::searchDirectory scans and watches.
+ * The rules only look at the names of the directory entries, they are evaluated before a path is built and before a file is
+ * opened or stat'ed, rejected files don't cost more than reading the directory.
+ * Glob patterns support '*' (any number of characters), '?' (a single character), character classes ("[abc]", "[a-z]", "[!a-z]")
+ * and '\' to escape the following character. Patterns are matched against the name only, never against the path.
+ */
+class DirectoryFilter final {
+public:
+    /// pass to maxDepth to search all subdirectories
+    static const std::size_t unlimited_depth = static_cast<std::size_t>(-1);
+
+    /**
+     * Scans files whose name matches the glob pattern.
+     * Without any include pattern files with the extension of shared libraries (DynamicLibrary::fileExtension()) are scanned.
+     */
+    DirectoryFilter& include(const std::string& pattern);
+
+    /**
+     * Scans files whose whole name matches the regular expression (ECMAScript grammar).
+     * Throws std::regex_error if the expression is invalid.
+     */
+    DirectoryFilter& includeRegex(const std::string& expression);
+
+    /// skips files and directories whose name matches the glob pattern, excludes take precedence over includes
+    DirectoryFilter& exclude(const std::string& pattern);
+
+    /**
+     * Skips files and directories whose whole name matches the regular expression (ECMAScript grammar).
+     * Throws std::regex_error if the expression is invalid.
+     */
+    DirectoryFilter& excludeRegex(const std::string& expression);
+
+    /**
+     * Sets how many levels of subdirectories are searched
+     * 0 (default) only searches the given directory, 1 additionally its direct subdirectories, etc.
+     */
+    DirectoryFilter& maxDepth(std::size_t depth);
+
+    std::size_t maxDepth() const {
+        return m_max_depth;
+    }
+
+    /// @returns true if a file named name (not null-terminated) has to be scanned
+    bool matchesFile(const char* name, std::size_t length) const;
+
+    /// @returns true if a directory named name (not null-terminated) has to be searched, the depth is not checked
+    bool matchesDirectory(const char* name, std::size_t length) const;
+
+    /**
+     * Checks a file found below the searched directory, including the directories leading to it and the depth
+     * @param relative_path path of the file relative to the searched directory
+     */
+    bool matchesPath(const std::string& relative_path) const;
+
+private:
+    bool excluded(const char* name, std::size_t length) const;
+
+    std::vector<std::string> m_include_patterns;
+    std::vector<std::string> m_exclude_patterns;
+    std::vector<std::regex>  m_include_expressions;
+    std::vector<std::regex>  m_exclude_expressions;
+    std::size_t              m_max_depth = 0;
+};
+}
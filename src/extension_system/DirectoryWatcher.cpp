@@ -0,0 +1,252 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#include "DirectoryWatcher.hpp"
+
+#include <array>
+#include <cstring>
+#include <thread>
+#include <unordered_set>
+
+#ifdef __linux__
+#include <dirent.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using extension_system::DirectoryWatcher;
+
+namespace {
+#ifdef __linux__
+constexpr std::uint32_t watch_mask
+    = IN_CREATE | IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE | IN_ONLYDIR | IN_EXCL_UNLINK | IN_DONT_FOLLOW;
+#endif
+} // namespace
+
+DirectoryWatcher::DirectoryWatcher() {
+#ifdef __linux__
+    m_inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+#endif
+}
+
+DirectoryWatcher::~DirectoryWatcher() noexcept {
+#ifdef __linux__
+    if (m_inotify_fd >= 0)
+        (void)close(m_inotify_fd);
+#endif
+}
+
+void DirectoryWatcher::watch(const std::string& root, bool recursive, Filter filter) {
+    watch(root, recursive ? static_cast<std::size_t>(-1) : 0, std::move(filter), {});
+}
+
+void DirectoryWatcher::watch(const std::string& root, std::size_t max_depth, Filter filter, DirectoryPredicate watch_directory) {
+    for (const auto& r : m_roots)
+        if (r.root == root && r.max_depth == max_depth)
+            return;
+
+    m_roots.push_back(Root{root, max_depth, std::move(filter), std::move(watch_directory), {}});
+
+    if (usesNotifications()) {
+        addWatches(root, m_roots.size() - 1, 0, nullptr);
+    } else {
+        // take the initial snapshot of the new root only, existing files are not reported as changed and pending changes of the
+        // other roots are kept
+        Changes ignored;
+        (void)poll(m_roots.back(), ignored);
+    }
+}
+
+DirectoryWatcher::Changes DirectoryWatcher::changes(std::chrono::milliseconds settle_time) {
+    Changes result;
+
+    if (usesNotifications()) {
+        if (read(result) == 0)
+            return result;
+#ifdef __linux__
+        while (settle_time.count() > 0) {
+            pollfd fd{m_inotify_fd, POLLIN, 0};
+            if (::poll(&fd, 1, static_cast<int>(settle_time.count())) <= 0 || read(result) == 0)
+                break;
+        }
+#endif
+    } else {
+        if (poll(result) == 0)
+            return result;
+        while (settle_time.count() > 0) {
+            std::this_thread::sleep_for(settle_time);
+            if (poll(result) == 0)
+                break;
+        }
+    }
+
+    // a file is reported only once, even if multiple events were received
+    std::unordered_set<std::string> seen;
+    std::vector<std::string>        files;
+    for (auto& f : result.files)
+        if (seen.insert(f).second)
+            files.push_back(std::move(f));
+    result.files = std::move(files);
+
+    return result;
+}
+
+void DirectoryWatcher::forEachWatchedFile(const std::function<void(const filesystem::path& p)>& func) const {
+    for (const auto& root : m_roots)
+        root.forEachFile(func);
+}
+
+void DirectoryWatcher::Root::forEachFile(const std::function<void(const filesystem::path& p)>& func) const {
+    // the walk stops at the same directories as the watches, the depth is checked by forEachFileInDirectory
+    filesystem::forEachFileInDirectory(
+        root,
+        [this](const char* name, std::size_t length, bool is_directory) {
+            return !is_directory || !watch_directory || watch_directory(name, length);
+        },
+        [&](const filesystem::path& p) {
+            if (filter(p))
+                func(p);
+        },
+        max_depth);
+}
+
+std::size_t DirectoryWatcher::read(Changes& result) {
+    std::size_t count = 0;
+#ifdef __linux__
+    alignas(inotify_event) std::array<char, 64 * 1024> buffer{};
+
+    for (;;) {
+        const auto length = ::read(m_inotify_fd, buffer.data(), buffer.size());
+        if (length <= 0)
+            break; // EAGAIN, no more events
+
+        for (std::size_t pos = 0; pos < static_cast<std::size_t>(length);) {
+            inotify_event event{};
+            std::memcpy(&event, buffer.data() + pos, sizeof(inotify_event));
+            const char* name = buffer.data() + pos + sizeof(inotify_event);
+            pos += sizeof(inotify_event) + event.len;
+            ++count;
+
+            if ((event.mask & IN_Q_OVERFLOW) != 0) {
+                result.overflow = true;
+                continue;
+            }
+
+            const auto iter = m_watches.find(event.wd);
+            if (iter == m_watches.end())
+                continue;
+
+            if ((event.mask & IN_IGNORED) != 0) {
+                m_watches.erase(iter);
+                continue;
+            }
+
+            if (event.len == 0)
+                continue;
+
+            const auto  watched = iter->second;
+            const auto& root    = m_roots[watched.root_index];
+            const auto  p       = filesystem::path{watched.dir} / std::string{name};
+
+            if ((event.mask & IN_ISDIR) != 0) {
+                if (!root.watches(name, std::strlen(name), watched.depth))
+                    continue;
+                if ((event.mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+                    addWatches(p.string(), watched.root_index, watched.depth + 1, &result);
+                else
+                    result.overflow = true; // the files within the directory are unknown
+            } else if (root.filter(p)) {
+                result.files.push_back(p.string());
+            }
+        }
+    }
+#else
+    (void)result;
+#endif
+    return count;
+}
+
+void DirectoryWatcher::addWatches(const std::string& dir, std::size_t root_index, std::size_t depth, Changes* result) {
+#ifdef __linux__
+    const int wd = inotify_add_watch(m_inotify_fd, dir.c_str(), watch_mask);
+    if (wd < 0)
+        return;
+    m_watches[wd] = WatchedDirectory{dir, root_index, depth};
+
+    // the entries below the depth limit only matter if the files of a new directory have to be reported
+    const auto& root = m_roots[root_index];
+    if (depth >= root.max_depth && result == nullptr)
+        return;
+
+    auto* dp = opendir(dir.c_str());
+    if (dp == nullptr)
+        return;
+
+    dirent* ep{};
+    while ((ep = readdir(dp)) != nullptr) {
+        const std::string name{ep->d_name};
+        if (name == "." || name == "..")
+            continue;
+
+        const auto p      = filesystem::path{dir} / name;
+        bool       is_dir = ep->d_type == DT_DIR;
+        if (ep->d_type == DT_UNKNOWN) {
+            struct stat sb { };
+            is_dir = lstat(p.string().c_str(), &sb) == 0 && S_ISDIR(sb.st_mode);
+        }
+
+        if (is_dir) {
+            if (root.watches(name.c_str(), name.length(), depth))
+                addWatches(p.string(), root_index, depth + 1, result);
+        } else if (result != nullptr && root.filter(p)) {
+            // files created before the watch was added
+            result->files.push_back(p.string());
+        }
+    }
+
+    (void)closedir(dp);
+#else
+    (void)dir;
+    (void)root_index;
+    (void)depth;
+    (void)result;
+#endif
+}
+
+std::size_t DirectoryWatcher::poll(Changes& result) {
+    std::size_t count = 0;
+    for (auto& root : m_roots)
+        count += poll(root, result);
+    return count;
+}
+
+std::size_t DirectoryWatcher::poll(Root& root, Changes& result) {
+    std::size_t count = 0;
+
+    std::unordered_map<std::string, filesystem::file_stamp> files;
+    root.forEachFile([&](const filesystem::path& p) {
+        filesystem::file_stamp stamp;
+        if (filesystem::get_file_stamp(p, stamp))
+            files.emplace(p.string(), stamp);
+    });
+
+    for (const auto& f : files) {
+        const auto iter = root.files.find(f.first);
+        if (iter == root.files.end() || iter->second != f.second) {
+            result.files.push_back(f.first);
+            ++count;
+        }
+    }
+
+    for (const auto& f : root.files) {
+        if (files.find(f.first) == files.end()) {
+            result.files.push_back(f.first);
+            ++count;
+        }
+    }
+
+    root.files = std::move(files);
+
+    return count;
+}
@@ -0,0 +1,98 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "filesystem.hpp"
+
+namespace extension_system {
+
+/**
+ * Observes directories for created, moved in, modified and deleted files.
+ * Uses inotify on linux and polls the directories on all other platforms or if inotify is unavailable.
+ */
+class DirectoryWatcher final {
+public:
+    using Filter = std::function<bool(const filesystem::path& p)>;
+    /// decides by the name (not null-terminated) of a subdirectory if it is watched
+    using DirectoryPredicate = std::function<bool(const char* name, std::size_t length)>;
+
+    struct Changes final {
+        std::vector<std::string> files;            ///< every changed file is only reported once
+        bool                     overflow = false; ///< events were lost, all watched directories have to be rescanned
+    };
+
+    DirectoryWatcher();
+    DirectoryWatcher(DirectoryWatcher&&)      = delete;
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(DirectoryWatcher&&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+    ~DirectoryWatcher() noexcept;
+
+    /**
+     * Starts watching a directory, calling watch for an already watched directory does nothing
+     * @param filter only changed files for which filter returns true are reported
+     */
+    void watch(const std::string& root, bool recursive, Filter filter);
+
+    /**
+     * Starts watching a directory and up to max_depth levels of subdirectories, calling watch for an already watched directory does nothing
+     * @param filter only changed files for which filter returns true are reported
+     * @param watch_directory only subdirectories for which watch_directory returns true are watched and rescanned, all if it is empty
+     */
+    void watch(const std::string& root, std::size_t max_depth, Filter filter, DirectoryPredicate watch_directory);
+
+    /**
+     * Returns all changes since the last call without blocking.
+     * Bursts of changes (e.g. package installs) are coalesced, as long as new changes arrive within settle_time they are collected.
+     */
+    Changes changes(std::chrono::milliseconds settle_time);
+
+    /// calls func for every file in all watched directories that passes the filter
+    void forEachWatchedFile(const std::function<void(const filesystem::path& p)>& func) const;
+
+    /// @returns true if the watcher is notified by the operating system and doesn't poll
+    bool usesNotifications() const {
+        return m_inotify_fd >= 0;
+    }
+
+private:
+    struct Root final {
+        std::string        root;
+        std::size_t        max_depth;
+        Filter             filter;
+        DirectoryPredicate watch_directory;
+
+        /// @returns true if the subdirectory name of a directory depth levels below root has to be watched
+        bool watches(const char* name, std::size_t length, std::size_t depth) const {
+            return depth < max_depth && (!watch_directory || watch_directory(name, length));
+        }
+
+        void forEachFile(const std::function<void(const filesystem::path& p)>& func) const;
+
+        // only used for polling
+        std::unordered_map<std::string, filesystem::file_stamp> files;
+    };
+
+    std::size_t read(Changes& result);
+    void        addWatches(const std::string& dir, std::size_t root_index, std::size_t depth, Changes* result);
+    std::size_t poll(Changes& result);
+    std::size_t poll(Root& root, Changes& result);
+
+    std::vector<Root> m_roots;
+    int               m_inotify_fd = -1;
+
+    struct WatchedDirectory final {
+        std::string dir;
+        std::size_t root_index;
+        std::size_t depth; // levels below the root
+    };
+
+    std::unordered_map<int, WatchedDirectory> m_watches;
+};
+}
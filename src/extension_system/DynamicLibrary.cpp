@@ -2,6 +2,10 @@
 /// SPDX-License-Identifier: BSL-1.0
 #include "DynamicLibrary.hpp"
 
+#include <cstdint>
+#include <cstdio>
+#include <utility>
+
 #ifdef _WIN32
 #ifndef WIN32_LEAN_AND_MEAN
 #define WIN32_LEAN_AND_MEAN
@@ -18,22 +22,189 @@
 #include <windows.h>
 #else // posix e.g. linux
 #include <dlfcn.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#if defined(__GLIBC__) && defined(LM_ID_NEWLM)
+#define EXTENSION_SYSTEM_HAS_LINK_NAMESPACES
+#include <algorithm>
+#include <mutex>
+#include <vector>
 #endif
 
 using extension_system::DynamicLibrary;
+using extension_system::LinkNamespace;
+
+namespace {
+// reads an unsigned integer stored with the byte order of the host
+template <typename T>
+T readUnsigned(const unsigned char* data) {
+    T result{};
+    for (std::size_t i = 0; i < sizeof(T); ++i)
+        reinterpret_cast<unsigned char*>(&result)[i] = data[i]; // NOLINT
+    return result;
+}
+
+// reads a little-endian unsigned integer
+template <typename T>
+T readLittleEndian(const unsigned char* data) {
+    T result{};
+    for (std::size_t i = sizeof(T); i > 0; --i)
+        result = static_cast<T>((result << 8U) | data[i - 1]);
+    return result;
+}
+
+#if !defined(_WIN32) && !defined(__APPLE__)
+// e_machine of the host, 0 if unknown
+constexpr std::uint16_t elf_machine =
+#if defined(__x86_64__)
+    62;
+#elif defined(__i386__)
+    3;
+#elif defined(__aarch64__)
+    183;
+#elif defined(__arm__)
+    40;
+#elif defined(__riscv)
+    243;
+#elif defined(__powerpc64__)
+    21;
+#elif defined(__powerpc__)
+    20;
+#elif defined(__s390x__)
+    22;
+#elif defined(__mips__)
+    8;
+#elif defined(__loongarch__)
+    258;
+#else
+    0;
+#endif
+#endif
+#ifdef EXTENSION_SYSTEM_HAS_LINK_NAMESPACES
+// Link-map namespaces are a process wide resource, glibc supports at most 16 including the global namespace.
+class LinkNamespaces final {
+public:
+    static LinkNamespaces& instance() {
+        static LinkNamespaces namespaces;
+        return namespaces;
+    }
+
+    void setMaxCount(std::size_t count) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        m_max_count = count;
+    }
+
+    // returns the handle and sets link_namespace, or returns nullptr if no namespace could be used
+    void* open(const std::string& filename, int flags, Lmid_t& link_namespace) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+
+        // reuse namespaces whose libraries were all unloaded before creating new ones
+        std::sort(m_namespaces.begin(), m_namespaces.end(), [](const Entry& a, const Entry& b) { return a.libraries < b.libraries; });
+
+        if (m_namespaces.empty() || (m_namespaces.front().libraries != 0 && m_namespaces.size() < m_max_count)) {
+            void* handle = dlmopen(LM_ID_NEWLM, filename.c_str(), flags);
+            if (handle != nullptr) {
+                Lmid_t id{};
+                if (dlinfo(handle, RTLD_DI_LMID, &id) == 0) {
+                    m_namespaces.push_back({id, 1});
+                    link_namespace = id;
+                    return handle;
+                }
+                (void)dlclose(handle);
+            }
+            // all namespaces of the dynamic loader are in use, share one of the existing namespaces
+        }
+
+        for (auto iter = m_namespaces.begin(); iter != m_namespaces.end();) {
+            void* handle = dlmopen(iter->id, filename.c_str(), flags);
+            if (handle != nullptr) {
+                ++iter->libraries;
+                link_namespace = iter->id;
+                return handle;
+            }
+            if (iter->libraries == 0)
+                iter = m_namespaces.erase(iter); // the dynamic loader already released the namespace
+            else
+                ++iter;
+        }
+
+        return nullptr;
+    }
+
+    void close(Lmid_t link_namespace) {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        for (auto& i : m_namespaces)
+            if (i.id == link_namespace && i.libraries > 0)
+                --i.libraries;
+    }
+
+private:
+    struct Entry final {
+        Lmid_t      id;
+        std::size_t libraries;
+    };
+
+    std::mutex         m_mutex;
+    std::size_t        m_max_count = 8;
+    std::vector<Entry> m_namespaces;
+};
+#endif
+} // namespace
 
 DynamicLibrary::DynamicLibrary(std::string filename)
-    : m_filename{std::move(filename)},
+    : DynamicLibrary(std::move(filename), false) { }
+
+DynamicLibrary::DynamicLibrary(std::string filename, bool allow_unload)
+    : DynamicLibrary(std::move(filename), allow_unload, LinkNamespace::Global) { }
+
+DynamicLibrary::DynamicLibrary(std::string filename, bool allow_unload, LinkNamespace link_namespace)
+    : m_filename{std::move(filename)} {
 #ifdef _WIN32
-    m_handle{LoadLibraryA(m_filename.c_str())}
+    (void)allow_unload;
+    (void)link_namespace;
+    m_handle = LoadLibraryA(m_filename.c_str());
 #else
-    m_handle{dlopen(m_filename.c_str(), RTLD_LAZY | RTLD_NODELETE)}
+    const int flags = allow_unload ? RTLD_LAZY : RTLD_LAZY | RTLD_NODELETE;
+#ifdef EXTENSION_SYSTEM_HAS_LINK_NAMESPACES
+    if (link_namespace == LinkNamespace::Isolated) {
+        Lmid_t id{};
+        m_handle = LinkNamespaces::instance().open(m_filename, flags, id);
+        if (m_handle != nullptr)
+            m_link_namespace = id;
+    }
+#else
+    (void)link_namespace;
+#endif
+    if (m_handle == nullptr)
+        m_handle = dlopen(m_filename.c_str(), flags);
 #endif
-{
     if (m_handle == nullptr)
         setLastError();
 }
 
+DynamicLibrary::DynamicLibrary(DynamicLibrary&& other) noexcept
+    : m_filename{std::move(other.m_filename)}
+    , m_handle{other.m_handle}
+    , m_last_error{std::move(other.m_last_error)}
+    , m_link_namespace{other.m_link_namespace} {
+    other.m_handle         = nullptr;
+    other.m_link_namespace = -1;
+}
+
+DynamicLibrary& DynamicLibrary::operator=(DynamicLibrary&& other) noexcept {
+    if (this != &other) {
+        DynamicLibrary tmp{std::move(other)};
+        std::swap(m_filename, tmp.m_filename);
+        std::swap(m_handle, tmp.m_handle);
+        std::swap(m_last_error, tmp.m_last_error);
+        std::swap(m_link_namespace, tmp.m_link_namespace);
+    }
+    return *this;
+}
+
 DynamicLibrary::~DynamicLibrary() noexcept {
     if (isValid()) {
 #ifdef _WIN32
@@ -42,6 +213,10 @@ DynamicLibrary::~DynamicLibrary() noexcept {
         dlclose(m_handle);
 #endif
     }
+#ifdef EXTENSION_SYSTEM_HAS_LINK_NAMESPACES
+    if (m_link_namespace != -1)
+        LinkNamespaces::instance().close(m_link_namespace);
+#endif
 }
 
 std::string DynamicLibrary::getFilename() const {
@@ -79,6 +254,154 @@ std::string DynamicLibrary::fileExtension() {
 #endif
 }
 
+bool DynamicLibrary::checkFileFormat(const std::string& filename, std::string& error) {
+    unsigned char header[64]{};
+
+#if defined(_WIN32)
+    std::FILE* file = std::fopen(filename.c_str(), "rb");
+    if (file == nullptr) {
+        error = "couldn't open file";
+        return false;
+    }
+    const auto length = std::fread(header, 1, sizeof(header), file);
+
+    // DOS header followed by the PE signature and the COFF header at e_lfanew
+    if (length < sizeof(header) || header[0] != 'M' || header[1] != 'Z') {
+        (void)std::fclose(file);
+        error = "not a PE file";
+        return false;
+    }
+
+    unsigned char pe[24]{};
+    const auto    pe_offset = readLittleEndian<std::uint32_t>(header + 0x3c);
+    const bool    pe_read   = std::fseek(file, static_cast<long>(pe_offset), SEEK_SET) == 0 && std::fread(pe, 1, sizeof(pe), file) == sizeof(pe);
+    (void)std::fclose(file);
+
+    if (!pe_read || pe[0] != 'P' || pe[1] != 'E' || pe[2] != 0 || pe[3] != 0) {
+        error = "invalid PE signature";
+        return false;
+    }
+
+#if defined(_M_X64) || defined(_M_AMD64)
+    const std::uint16_t machine = 0x8664;
+#elif defined(_M_ARM64)
+    const std::uint16_t machine = 0xaa64;
+#elif defined(_M_IX86)
+    const std::uint16_t machine = 0x14c;
+#else
+    const std::uint16_t machine = 0;
+#endif
+    if (machine != 0 && readLittleEndian<std::uint16_t>(pe + 4) != machine) {
+        error = "PE file was built for another architecture";
+        return false;
+    }
+    if ((readLittleEndian<std::uint16_t>(pe + 22) & 0x2000U) == 0) { // IMAGE_FILE_DLL
+        error = "PE file is not a dll";
+        return false;
+    }
+#else
+    // only the header is read, stdio would fill a whole buffer; O_NONBLOCK prevents blocking on FIFOs
+    const int fd = open(filename.c_str(), O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0) {
+        error = "couldn't open file";
+        return false;
+    }
+    struct stat sb { };
+    const bool  is_file = fstat(fd, &sb) == 0 && S_ISREG(sb.st_mode);
+    const auto  length  = is_file ? pread(fd, header, sizeof(header), 0) : -1;
+    (void)close(fd);
+
+    if (!is_file) {
+        error = "not a regular file";
+        return false;
+    }
+    if (length < 0) {
+        error = "couldn't read file";
+        return false;
+    }
+
+#if defined(__APPLE__)
+    if (sb.st_size < 16 || length < 16) {
+        error = "file is too small";
+        return false;
+    }
+
+    const auto magic = readUnsigned<std::uint32_t>(header);
+    if (magic == 0xbebafecaU || magic == 0xcafebabeU)
+        return true; // universal binary, the dynamic loader picks the architecture
+
+    if (magic != (sizeof(void*) == 8 ? 0xfeedfacfU : 0xfeedfaceU)) {
+        error = "not a Mach-O file for this architecture";
+        return false;
+    }
+
+#if defined(__x86_64__)
+    const std::uint32_t cpu_type = 0x01000007;
+#elif defined(__aarch64__) || defined(__arm64__)
+    const std::uint32_t cpu_type = 0x0100000c;
+#else
+    const std::uint32_t cpu_type = 0;
+#endif
+    if (cpu_type != 0 && readUnsigned<std::uint32_t>(header + 4) != cpu_type) {
+        error = "Mach-O file was built for another architecture";
+        return false;
+    }
+
+    const auto file_type = readUnsigned<std::uint32_t>(header + 12);
+    if (file_type != 6 && file_type != 8) { // MH_DYLIB, MH_BUNDLE
+        error = "Mach-O file is neither a dylib nor a bundle";
+        return false;
+    }
+#else
+    const auto header_size = sizeof(void*) == 8 ? 64 : 52; // size of the ELF header
+    if (sb.st_size < header_size || length < header_size) {
+        error = "file is too small";
+        return false;
+    }
+
+    if (header[0] != 0x7f || header[1] != 'E' || header[2] != 'L' || header[3] != 'F') {
+        error = "not an ELF file";
+        return false;
+    }
+
+    if (header[4] != (sizeof(void*) == 8 ? 2 : 1)) {
+        error = "ELF file has the wrong class (32/64 bit)";
+        return false;
+    }
+
+    const std::uint16_t one = 1;
+    if (header[5] != (*reinterpret_cast<const unsigned char*>(&one) == 1 ? 1 : 2)) { // NOLINT
+        error = "ELF file has the wrong byte order";
+        return false;
+    }
+
+    if (readUnsigned<std::uint16_t>(header + 16) != 3) { // ET_DYN
+        error = "ELF file is not a shared object";
+        return false;
+    }
+
+    if (elf_machine != 0 && readUnsigned<std::uint16_t>(header + 18) != elf_machine) {
+        error = "ELF file was built for another architecture";
+        return false;
+    }
+#endif
+#endif
+
+    return true;
+}
+
+LinkNamespace DynamicLibrary::getLinkNamespace() const {
+    return m_link_namespace == -1 ? LinkNamespace::Global : LinkNamespace::Isolated;
+}
+
+void DynamicLibrary::setMaxLinkNamespaces(std::size_t count) {
+#ifdef EXTENSION_SYSTEM_HAS_LINK_NAMESPACES
+    LinkNamespaces::instance().setMaxCount(count);
+#else
+    (void)count;
+#endif
+}
+
 bool DynamicLibrary::isValid() const {
     return m_handle != nullptr;
 }
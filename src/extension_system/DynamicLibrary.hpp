@@ -7,13 +7,31 @@
 
 namespace extension_system {
 
+/**
+ * Defines the link-map namespace a library is loaded into
+ */
+enum class LinkNamespace {
+    Global,  ///< the symbols of the library and its dependencies are resolved within the global namespace of the process
+    Isolated ///< the library and its dependencies get their own namespace (dlmopen), only supported with glibc
+};
+
 class DynamicLibrary final {
 public:
     DynamicLibrary() = default;
     explicit DynamicLibrary(std::string filename);
-    DynamicLibrary(DynamicLibrary&&)      = default;
+    /**
+     * @param allow_unload if false the library stays in memory even after it was closed (RTLD_NODELETE)
+     */
+    DynamicLibrary(std::string filename, bool allow_unload);
+    /**
+     * @param allow_unload if false the library stays in memory even after it was closed (RTLD_NODELETE)
+     * @param link_namespace namespace to load the library into, if no isolated namespace is available or the platform doesn't
+     *        support namespaces the library is loaded into the global namespace
+     */
+    DynamicLibrary(std::string filename, bool allow_unload, LinkNamespace link_namespace);
+    DynamicLibrary(DynamicLibrary&& other) noexcept;
     DynamicLibrary(const DynamicLibrary&) = delete;
-    DynamicLibrary& operator=(DynamicLibrary&&) = default;
+    DynamicLibrary& operator=(DynamicLibrary&& other) noexcept;
     DynamicLibrary& operator=(const DynamicLibrary&) noexcept = delete;
     ~DynamicLibrary() noexcept;
 
@@ -30,6 +48,24 @@ public:
 
     static std::string fileExtension();
 
+    /**
+     * Checks the header of a file (ELF, PE or Mach-O) without reading the whole file.
+     * Rejects files that can't be loaded as shared library for the current platform and architecture,
+     * e.g. linker scripts, executables or libraries built for other architectures.
+     * @param error set to the reason if the file was rejected
+     */
+    static bool checkFileFormat(const std::string& filename, std::string& error);
+
+    /// @returns the namespace the library was actually loaded into
+    LinkNamespace getLinkNamespace() const;
+
+    /**
+     * Sets the maximal number of isolated namespaces. The number of namespaces is limited by the dynamic loader (glibc: 15).
+     * If all namespaces are in use, new isolated libraries are loaded into the namespace with the fewest libraries.
+     * Namespaces whose libraries were all unloaded are reused.
+     */
+    static void setMaxLinkNamespaces(std::size_t count);
+
     bool isValid() const;
 
     std::string getError() const;
@@ -38,6 +74,7 @@ private:
     std::string m_filename;
     void*       m_handle{};
     std::string m_last_error;
+    long        m_link_namespace = -1; // id of the isolated namespace or -1 if the global namespace is used
 
     void setLastError();
 };
@@ -47,11 +47,276 @@
     #endif
 #endif
 
-#define EXTENSION_SYSTEM_EXTENSION_API_VERSION 1
+// C++14 allows to verify and encode the metadata at compile time, with C++11 the entries are exported as they are
+#if defined(__cpp_constexpr) && __cpp_constexpr >= 201304L
+#define EXTENSION_SYSTEM_CONSTEXPR_METADATA
+#endif
+
+// encodings of the metadata, the ExtensionSystem reads both
+#define EXTENSION_SYSTEM_EXTENSION_API_VERSION_TEXT 1   // key=value pairs
+#define EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY 2 // fixed header and length-prefixed keys and values, requires C++14
+#define EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_TEXT EXTENSION_SYSTEM_STR(EXTENSION_SYSTEM_EXTENSION_API_VERSION_TEXT)
+#define EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_BINARY EXTENSION_SYSTEM_STR(EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY)
+
+#ifdef EXTENSION_SYSTEM_CONSTEXPR_METADATA
+#define EXTENSION_SYSTEM_EXTENSION_API_VERSION EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY
+#else
+#define EXTENSION_SYSTEM_EXTENSION_API_VERSION EXTENSION_SYSTEM_EXTENSION_API_VERSION_TEXT
+#endif
 #define EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR EXTENSION_SYSTEM_STR(EXTENSION_SYSTEM_EXTENSION_API_VERSION)
 
 #define EXTENSION_SYSTEM_DESCRIPTION_ENTRY(key, value) key "=" value "\0"
 
+// semantic version of an extension (see ExtensionDescription::semanticVersion), has to be passed as user defined metadata
+#define EXTENSION_SYSTEM_SEMANTIC_VERSION_ENTRY(_major, _minor, _patch) \
+    EXTENSION_SYSTEM_DESCRIPTION_ENTRY("semantic_version", \
+                                       EXTENSION_SYSTEM_STR(_major) "." EXTENSION_SYSTEM_STR(_minor) "." EXTENSION_SYSTEM_STR(_patch))
+
+#define EXTENSION_SYSTEM_METADATA_START_ENTRY \
+    EXTENSION_SYSTEM_DESCRIPTION_ENTRY("EXTENSION_SYSTEM_METADATA_DESCRIPTION" "_START", EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR)
+#define EXTENSION_SYSTEM_METADATA_END "EXTENSION_SYSTEM_METADATA_DESCRIPTION" "_END"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace extension_system {
+namespace detail {
+/*
+ * Binary metadata (API version 2) follows the start entry, all numbers are little endian:
+ *   header: magic "ESMD", API version (16 bit), number of entries (16 bit), length of the entries in bytes (32 bit),
+ *           extension version (32 bit), FNV-1a of the interface name (64 bit), FNV-1a of the header up to here and the entries (64 bit)
+ *   entry:  key length (16 bit), key, value length (32 bit), value
+ * The ExtensionSystem takes the entries and the version without tokenizing them if the checksum matches.
+ */
+constexpr const char        binary_metadata_magic[]     = "ESMD";
+constexpr const std::size_t binary_metadata_header_size = 4 + 2 + 2 + 4 + 4 + 8 + 8;
+}
+}
+
+#ifdef EXTENSION_SYSTEM_CONSTEXPR_METADATA
+namespace extension_system {
+namespace detail {
+template <std::size_t N>
+struct Metadata final {
+    char data[N];
+};
+
+/// a part of the entries, found is false if the searched entry doesn't exist
+struct MetadataRange final {
+    std::size_t begin;
+    std::size_t length;
+    bool        found;
+};
+
+constexpr std::uint64_t fnv1a(const char* data, std::size_t length, std::uint64_t hash = 14695981039346656037ULL) {
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+constexpr std::size_t entryEnd(const char* entries, std::size_t length, std::size_t begin) {
+    while (begin < length && entries[begin] != '\0')
+        ++begin;
+    return begin;
+}
+
+constexpr std::size_t keyLength(const char* entries, std::size_t begin, std::size_t end) {
+    std::size_t i = begin;
+    while (i < end && entries[i] != '=')
+        ++i;
+    return i - begin;
+}
+
+constexpr std::size_t entryCount(const char* entries, std::size_t length) {
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < length; ++i)
+        count += entries[i] == '\0' ? 1 : 0;
+    return count;
+}
+
+/// every entry has a non-empty key followed by '=' and is terminated by '\0'
+constexpr bool entriesAreWellFormed(const char* entries, std::size_t length) {
+    for (std::size_t begin = 0; begin < length;) {
+        const auto end = entryEnd(entries, length, begin);
+        const auto key = keyLength(entries, begin, end);
+        if (end == length || key == 0 || begin + key == end)
+            return false;
+        begin = end + 1;
+    }
+    return true;
+}
+
+constexpr bool keysFit(const char* entries, std::size_t length) {
+    for (std::size_t begin = 0; begin < length; begin = entryEnd(entries, length, begin) + 1) {
+        if (keyLength(entries, begin, entryEnd(entries, length, begin)) > 0xffffU)
+            return false;
+    }
+    return true;
+}
+
+constexpr bool keysEqual(const char* entries, std::size_t a, std::size_t a_length, const char* key, std::size_t key_length) {
+    if (a_length != key_length)
+        return false;
+    for (std::size_t i = 0; i < key_length; ++i)
+        if (entries[a + i] != key[i])
+            return false;
+    return true;
+}
+
+constexpr bool hasDuplicateKeys(const char* entries, std::size_t length) {
+    for (std::size_t a = 0; a < length; a = entryEnd(entries, length, a) + 1) {
+        const auto a_length = keyLength(entries, a, entryEnd(entries, length, a));
+        for (std::size_t b = entryEnd(entries, length, a) + 1; b < length; b = entryEnd(entries, length, b) + 1) {
+            if (keysEqual(entries, b, keyLength(entries, b, entryEnd(entries, length, b)), entries + a, a_length))
+                return true;
+        }
+    }
+    return false;
+}
+
+constexpr MetadataRange findValue(const char* entries, std::size_t length, const char* key, std::size_t key_length) {
+    for (std::size_t begin = 0; begin < length; begin = entryEnd(entries, length, begin) + 1) {
+        const auto end = entryEnd(entries, length, begin);
+        if (keysEqual(entries, begin, keyLength(entries, begin, end), key, key_length))
+            return {begin + key_length + 1, end - begin - key_length - 1, true};
+    }
+    return {0, 0, false};
+}
+
+template <std::size_t K>
+constexpr bool hasValue(const char* entries, std::size_t length, const char (&key)[K]) {
+    const auto value = findValue(entries, length, key, K - 1);
+    return value.found && value.length != 0;
+}
+
+template <std::size_t K>
+constexpr bool hasKey(const char* entries, std::size_t length, const char (&key)[K]) {
+    return findValue(entries, length, key, K - 1).found;
+}
+
+/// the version is a decimal number that fits into 32 bits
+constexpr bool isVersion(const char* entries, std::size_t length) {
+    const auto    value   = findValue(entries, length, "version", 7);
+    std::uint64_t version = 0;
+    for (std::size_t i = value.begin; i < value.begin + value.length; ++i) {
+        if (entries[i] < '0' || entries[i] > '9')
+            return false;
+        version = version * 10 + static_cast<std::uint64_t>(entries[i] - '0');
+        if (version > 0xffffffffULL)
+            return false;
+    }
+    return value.found && value.length != 0;
+}
+
+/// the semantic version is optional, if it exists it is major.minor.patch and every part fits into 32 bits
+constexpr bool isSemanticVersion(const char* entries, std::size_t length) {
+    const auto    value  = findValue(entries, length, "semantic_version", 16);
+    std::size_t   parts  = 1;
+    std::uint64_t number = 0;
+    bool          digits = false;
+    for (std::size_t i = value.begin; i < value.begin + value.length; ++i) {
+        if (entries[i] == '.') {
+            if (!digits || ++parts > 3)
+                return false;
+            number = 0;
+            digits = false;
+        } else if (entries[i] >= '0' && entries[i] <= '9') {
+            number = number * 10 + static_cast<std::uint64_t>(entries[i] - '0');
+            digits = true;
+            if (number > 0xffffffffULL)
+                return false;
+        } else {
+            return false;
+        }
+    }
+    return !value.found || (parts == 3 && digits);
+}
+
+constexpr std::uint32_t versionNumber(const char* entries, std::size_t length) {
+    const auto    value   = findValue(entries, length, "version", 7);
+    std::uint32_t version = 0;
+    for (std::size_t i = value.begin; i < value.begin + value.length; ++i)
+        version = version * 10 + static_cast<std::uint32_t>(entries[i] - '0');
+    return version;
+}
+
+template <std::size_t M>
+constexpr std::size_t append(char (&out)[M], std::size_t pos, const char* data, std::size_t length) {
+    for (std::size_t i = 0; i < length; ++i)
+        out[pos++] = data[i];
+    return pos;
+}
+
+template <std::size_t M>
+constexpr std::size_t appendNumber(char (&out)[M], std::size_t pos, std::uint64_t value, std::size_t bytes) {
+    for (std::size_t i = 0; i < bytes; ++i)
+        out[pos++] = static_cast<char>((value >> (i * 8)) & 0xffU);
+    return pos;
+}
+
+/// start entry, header, Count entries and end tag, every entry grows by 4 bytes (16 and 32 bit lengths instead of '=' and '\0')
+template <std::size_t Count, std::size_t S, std::size_t N, std::size_t E>
+constexpr Metadata<S - 1 + binary_metadata_header_size + N - 1 + 4 * Count + E> makeMetadata(const char (&start)[S],
+                                                                                                const char (&entries)[N],
+                                                                                                const char (&end)[E]) {
+    Metadata<S - 1 + binary_metadata_header_size + N - 1 + 4 * Count + E> result{};
+
+    const auto        interface_name = findValue(entries, N - 1, "interface_name", 14);
+    const std::size_t header         = append(result.data, 0, start, S - 1);
+    std::size_t       pos            = append(result.data, header, binary_metadata_magic, sizeof(binary_metadata_magic) - 1);
+    pos                              = appendNumber(result.data, pos, EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY, 2);
+    pos                              = appendNumber(result.data, pos, Count, 2);
+    pos                              = appendNumber(result.data, pos, N - 1 + 4 * Count, 4);
+    pos                              = appendNumber(result.data, pos, versionNumber(entries, N - 1), 4);
+    pos = appendNumber(result.data, pos, fnv1a(entries + interface_name.begin, interface_name.length), 8);
+
+    const std::size_t checksum = pos;
+    pos += 8;
+    for (std::size_t begin = 0; begin < N - 1;) {
+        const auto entry_end = entryEnd(entries, N - 1, begin);
+        const auto key       = keyLength(entries, begin, entry_end);
+        pos                  = appendNumber(result.data, pos, key, 2);
+        pos                  = append(result.data, pos, entries + begin, key);
+        pos                  = appendNumber(result.data, pos, entry_end - begin - key - 1, 4);
+        pos                  = append(result.data, pos, entries + begin + key + 1, entry_end - begin - key - 1);
+        begin                = entry_end + 1;
+    }
+
+    const auto header_hash = fnv1a(result.data + header, checksum - header);
+    (void)appendNumber(result.data, checksum, fnv1a(result.data + checksum + 8, pos - checksum - 8, header_hash), 8);
+    (void)append(result.data, pos, end, E);
+    return result;
+}
+}
+}
+
+#define EXTENSION_SYSTEM_METADATA_CHECKS(_entries) \
+    static_assert(extension_system::detail::entriesAreWellFormed(_entries, sizeof(_entries) - 1), \
+                  "every metadata entry needs a key followed by '=' and has to be added with EXTENSION_SYSTEM_DESCRIPTION_ENTRY"); \
+    static_assert(!extension_system::detail::hasDuplicateKeys(_entries, sizeof(_entries) - 1), "metadata keys have to be unique"); \
+    static_assert(extension_system::detail::hasValue(_entries, sizeof(_entries) - 1, "name"), "the name can not be empty"); \
+    static_assert(extension_system::detail::hasValue(_entries, sizeof(_entries) - 1, "interface_name"), "interface_name can not be empty"); \
+    static_assert(extension_system::detail::hasValue(_entries, sizeof(_entries) - 1, "entry_point"), "entry_point can not be empty"); \
+    static_assert(extension_system::detail::isVersion(_entries, sizeof(_entries) - 1), "the version has to be a 32 bit unsigned number"); \
+    static_assert(extension_system::detail::isSemanticVersion(_entries, sizeof(_entries) - 1), \
+                  "the semantic version has to be major.minor.patch, every part has to be a 32 bit unsigned number"); \
+    static_assert(extension_system::detail::entryCount(_entries, sizeof(_entries) - 1) <= 0xffffU, "too many metadata entries"); \
+    static_assert(extension_system::detail::keysFit(_entries, sizeof(_entries) - 1), "metadata keys can't be longer than 65535 characters");
+
+// the metadata is a constant, it is found by scanning the library without loading it
+#define EXTENSION_SYSTEM_METADATA(_entries) \
+    EXTENSION_SYSTEM_METADATA_CHECKS(_entries) \
+    static constexpr auto extension_system_metadata \
+        = extension_system::detail::makeMetadata<extension_system::detail::entryCount(_entries, sizeof(_entries) - 1)>( \
+            EXTENSION_SYSTEM_METADATA_START_ENTRY, _entries, EXTENSION_SYSTEM_METADATA_END); \
+    const char* extension_system_export = extension_system_metadata.data;
+#else
+#define EXTENSION_SYSTEM_METADATA(_entries) \
+    const char* extension_system_export = EXTENSION_SYSTEM_METADATA_START_ENTRY _entries EXTENSION_SYSTEM_METADATA_END;
+#endif
+
 /**
  * You have to pass a fully qualified interface name (_interface).
  * your class should have a virtual destructor
@@ -59,8 +324,7 @@
 #define EXTENSION_SYSTEM_EXTENSION_EXT(_interface, _classname, _name, _version, _description, _user_defined, _function_name) \
     extern "C" EXTENSION_SYSTEM_EXPORT _interface* EXTENSION_SYSTEM_CDECL _function_name(_interface *, const char **); \
     extern "C" EXTENSION_SYSTEM_EXPORT _interface* EXTENSION_SYSTEM_CDECL _function_name(_interface *freeExtension, const char **data) { \
-        const char *extension_system_export = \
-            EXTENSION_SYSTEM_DESCRIPTION_ENTRY("EXTENSION_SYSTEM_METADATA_DESCRIPTION" "_START", EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR) \
+        EXTENSION_SYSTEM_METADATA( \
             EXTENSION_SYSTEM_DESCRIPTION_ENTRY("compiler", EXTENSION_SYSTEM_COMPILER) \
             EXTENSION_SYSTEM_DESCRIPTION_ENTRY("compiler_version", EXTENSION_SYSTEM_COMPILER_VERSION_STR) \
             EXTENSION_SYSTEM_DESCRIPTION_ENTRY("build_type", EXTENSION_SYSTEM_BUILD_TYPE) \
@@ -69,8 +333,7 @@
             EXTENSION_SYSTEM_DESCRIPTION_ENTRY("version", EXTENSION_SYSTEM_STR(_version)) \
             EXTENSION_SYSTEM_DESCRIPTION_ENTRY("description", _description) \
             EXTENSION_SYSTEM_DESCRIPTION_ENTRY("entry_point", EXTENSION_SYSTEM_STR(_function_name)) \
-            _user_defined \
-            "EXTENSION_SYSTEM_METADATA_DESCRIPTION" "_END"; \
+            _user_defined) \
             if( freeExtension != nullptr ) {\
                 delete freeExtension;\
                 return nullptr;\
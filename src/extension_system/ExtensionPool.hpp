@@ -0,0 +1,260 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "ExtensionSystem.hpp"
+
+namespace extension_system {
+
+/**
+ * Pool of instances of a single extension.
+ * Instances are created through ExtensionSystem::createExtension and are recycled instead of being freed when the last reference
+ * handed out by acquire() is released. This avoids paying the construction costs of expensive extensions for every use.
+ * Released instances are first put into a small cache of the releasing thread and then into a shared free list.
+ * Both together keep at most max_idle instances, instances that don't fit are freed.
+ * The thread caches belong to the pool, all instances kept by the pool are freed with it.
+ * Acquired instances can outlive the pool, they are freed on release in that case.
+ * thread-safe
+ */
+template <class T>
+class ExtensionPool final {
+public:
+    using Factory       = std::function<std::shared_ptr<T>()>;
+    using ResetFunction = std::function<void(T&)>;
+    using UniquePtr     = std::unique_ptr<T, std::function<void(T*)>>;
+
+    /**
+     * Creates a pool for the extension described by desc
+     * The ExtensionSystem has to outlive the pool
+     * @param max_idle Maximum number of released instances kept by the pool (shared free list and thread caches)
+     * @param max_thread_cached Maximum number of released instances kept per thread
+     */
+    ExtensionPool(ExtensionSystem& extension_system, ExtensionDescription desc, std::size_t max_idle = 16, std::size_t max_thread_cached = 2)
+        : ExtensionPool([&extension_system, desc] { return extension_system.createExtension<T>(desc); }, max_idle, max_thread_cached) {}
+
+    /**
+     * Creates a pool for the highest version of the extension with the given name
+     * The ExtensionSystem has to outlive the pool
+     */
+    ExtensionPool(ExtensionSystem& extension_system, const std::string& name, std::size_t max_idle = 16, std::size_t max_thread_cached = 2)
+        : ExtensionPool([&extension_system, name] { return extension_system.createExtension<T>(name); }, max_idle, max_thread_cached) {}
+
+    /**
+     * Creates a pool that uses a custom factory to create new instances, e.g. a lambda calling createExtension with a specific version
+     */
+    explicit ExtensionPool(Factory factory, std::size_t max_idle = 16, std::size_t max_thread_cached = 2)
+        : m_state{std::make_shared<State>()} {
+        m_state->factory           = std::move(factory);
+        m_state->max_idle          = max_idle;
+        m_state->max_thread_cached = max_thread_cached;
+        if (max_thread_cached != 0)
+            m_state->thread_caches = std::vector<ThreadCache>(std::max(1U, std::thread::hardware_concurrency()));
+    }
+
+    // not movable, a moved-from pool would have no state to work on
+    ExtensionPool(ExtensionPool&&)      = delete;
+    ExtensionPool(const ExtensionPool&) = delete;
+    ExtensionPool& operator=(ExtensionPool&&) = delete;
+    ExtensionPool& operator=(const ExtensionPool&) = delete;
+    ~ExtensionPool() noexcept                      = default;
+
+    /**
+     * Sets a function that is called for every instance before it is put back into the pool.
+     * The function has to bring the instance into a state that is indistinguishable from a newly created one.
+     * If the function throws, the instance is freed instead of being recycled.
+     * @param func Reset function or nullptr to recycle instances as they are
+     */
+    void setResetHandler(ResetFunction func) {
+        std::lock_guard<std::mutex> lock{m_state->mutex};
+        m_state->reset = std::move(func);
+    }
+
+    /**
+     * Returns a pooled instance or creates a new one if the pool is empty.
+     * @return An instance of the extension or nullptr, if the extension could not be instantiated
+     */
+    std::shared_ptr<T> acquire() {
+        auto instance = take();
+        if (instance == nullptr)
+            return {};
+        T* obj = instance.get();
+        return std::shared_ptr<T>(obj, Recycler{m_state, std::move(instance)});
+    }
+
+    /**
+     * Same as acquire(), but returns a std::unique_ptr
+     */
+    UniquePtr acquireUnique() {
+        auto instance = take();
+        if (instance == nullptr)
+            return UniquePtr{nullptr, [](T*) {}};
+        T* obj = instance.get();
+        return UniquePtr{obj, Recycler{m_state, std::move(instance)}};
+    }
+
+    /**
+     * Creates instances until the shared free list contains count instances (limited by max_idle, including the thread caches)
+     * @return number of instances in the shared free list
+     */
+    std::size_t reserve(std::size_t count) {
+        std::unique_lock<std::mutex> lock{m_state->mutex};
+        while (m_state->idle.size() < count && m_state->retain()) {
+            lock.unlock();
+            auto instance = m_state->factory();
+            lock.lock();
+            if (instance == nullptr) {
+                --m_state->retained;
+                break;
+            }
+            m_state->idle.push_back(std::move(instance));
+        }
+        return m_state->idle.size();
+    }
+
+    /**
+     * Returns the number of instances in the shared free list (thread caches are not included)
+     */
+    std::size_t idle() const {
+        std::lock_guard<std::mutex> lock{m_state->mutex};
+        return m_state->idle.size();
+    }
+
+    /**
+     * Frees all instances in the shared free list and the thread caches
+     */
+    void clear() {
+        std::vector<std::shared_ptr<T>> tmp;
+        for (auto& cache : m_state->thread_caches) {
+            std::lock_guard<std::mutex> lock{cache.mutex};
+            std::move(cache.instances.begin(), cache.instances.end(), std::back_inserter(tmp));
+            cache.instances.clear();
+        }
+        {
+            std::lock_guard<std::mutex> lock{m_state->mutex};
+            std::move(m_state->idle.begin(), m_state->idle.end(), std::back_inserter(tmp));
+            m_state->idle.clear();
+        }
+        m_state->retained -= tmp.size();
+    }
+
+private:
+    // released instances of the threads mapped to the cache, its mutex is only contended if there are more threads than caches
+    struct ThreadCache final {
+        std::mutex                      mutex;
+        std::vector<std::shared_ptr<T>> instances;
+    };
+
+    struct State final {
+        std::mutex                      mutex;
+        Factory                         factory;
+        ResetFunction                   reset;
+        std::size_t                     max_idle{};
+        std::size_t                     max_thread_cached{};
+        std::vector<std::shared_ptr<T>> idle;
+        std::vector<ThreadCache>        thread_caches;
+        std::atomic<std::size_t>        retained{0}; // instances in idle and thread_caches
+
+        /// counts an instance that is kept by the pool, fails if the pool already keeps max_idle instances
+        bool retain() {
+            auto count = retained.load();
+            do {
+                if (count >= max_idle)
+                    return false;
+            } while (!retained.compare_exchange_weak(count, count + 1));
+            return true;
+        }
+
+        ThreadCache& threadCache() {
+            return thread_caches[threadIndex() % thread_caches.size()];
+        }
+    };
+
+    // threads are numbered in the order they use a pool for the first time, consecutive threads use different caches
+    static std::size_t threadIndex() {
+        static std::atomic<std::size_t>       next{0};
+        static thread_local const std::size_t index = next++;
+        return index;
+    }
+
+    struct Recycler final {
+        std::weak_ptr<State> state;
+        std::shared_ptr<T>   instance;
+
+        void operator()(T*) {
+            auto s = state.lock();
+            if (s == nullptr) {
+                instance.reset(); // pool is gone, free the instance
+                return;
+            }
+
+            ResetFunction reset;
+            {
+                std::lock_guard<std::mutex> lock{s->mutex};
+                reset = s->reset;
+            }
+
+            if (reset) {
+                try {
+                    reset(*instance);
+                } catch (...) {
+                    instance.reset();
+                    return;
+                }
+            }
+
+            if (!s->retain()) {
+                instance.reset();
+                return;
+            }
+
+            if (!s->thread_caches.empty()) {
+                auto&                       cache = s->threadCache();
+                std::lock_guard<std::mutex> lock{cache.mutex};
+                if (cache.instances.size() < s->max_thread_cached) {
+                    cache.instances.push_back(std::move(instance));
+                    return;
+                }
+            }
+
+            std::lock_guard<std::mutex> lock{s->mutex};
+            s->idle.push_back(std::move(instance));
+        }
+    };
+
+    std::shared_ptr<T> take() {
+        if (!m_state->thread_caches.empty()) {
+            auto&                       cache = m_state->threadCache();
+            std::lock_guard<std::mutex> lock{cache.mutex};
+            if (!cache.instances.empty()) {
+                auto instance = std::move(cache.instances.back());
+                cache.instances.pop_back();
+                --m_state->retained;
+                return instance;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock{m_state->mutex};
+            if (!m_state->idle.empty()) {
+                auto instance = std::move(m_state->idle.back());
+                m_state->idle.pop_back();
+                --m_state->retained;
+                return instance;
+            }
+        }
+
+        return m_state->factory();
+    }
+
+    std::shared_ptr<State> m_state;
+};
+}
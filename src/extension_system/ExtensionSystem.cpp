@@ -2,69 +2,173 @@
 /// SPDX-License-Identifier: BSL-1.0
 #include "ExtensionSystem.hpp"
 
+#include "Arena.hpp"
+#include "DirectoryFilter.hpp"
+#include "DirectoryWatcher.hpp"
+#include "MetadataReader.hpp"
+#include "StringSearch.hpp"
 #include "filesystem.hpp"
-#include "string.hpp"
 #include <algorithm>
 #include <iostream>
 #include <unordered_set>
 
-#ifdef EXTENSION_SYSTEM_USE_BOOST
-#ifdef _WIN32
-#define BOOST_DATE_TIME_NO_LIB
-#endif
-#include <boost/algorithm/searching/boyer_moore.hpp>
-#include <boost/interprocess/file_mapping.hpp>
-#include <boost/interprocess/mapped_region.hpp>
-#else
-#include <fstream>
-#endif
-
 using namespace extension_system;
 
 namespace {
-inline std::string getRealFilename(const std::string& filename) {
-    filesystem::path filen{filename};
+// resolves the canonical name of filename or filename + DynamicLibrary::fileExtension(), @returns an empty string if neither exist
+inline std::string getRealFilename(const std::string&         filename,
+                                   filesystem::path_resolver& resolver,
+                                   filesystem::file_stamp&    stamp,
+                                   bool&                      is_directory) {
+    std::string real_path;
+    if (resolver.resolve(filename, real_path, stamp, is_directory)
+        || resolver.resolve(filename + DynamicLibrary::fileExtension(), real_path, stamp, is_directory))
+        return real_path;
+    return {};
+}
 
-    if (!filesystem::exists(filen)) { // check if the file exists
-        filen = filesystem::path{filename + DynamicLibrary::fileExtension()};
-        if (!filesystem::exists(filen))
-            return {};
-    }
+// the name a file had in m_known_extensions before it was deleted
+inline std::string getDeletedFilename(const std::string& filename, filesystem::path_resolver& resolver) {
+    const filesystem::path p{filename};
+    return (filesystem::path{resolver.directory(p.parent_path())} / p.filename()).generic_string();
+}
 
-    return canonical(filen).generic_string();
+template <typename StampA, typename StampB>
+inline bool equalStamps(const StampA& a, const StampB& b) {
+    return a.device == b.device && a.inode == b.inode && a.size == b.size && a.modification_time == b.modification_time;
 }
 
-#ifdef EXTENSION_SYSTEM_USE_BOOST
-using StringSearch = boost::algorithm::boyer_moore<const char*>;
-#else
-class StringSearch final {
-public:
-    StringSearch(const char* pattern_first, const char* pattern_last)
-        : _pattern_first(pattern_first)
-        , _pattern_last(pattern_last) { }
+template <typename Entry>
+inline bool hasKey(const Entry& entry, const char* key, std::size_t key_size) {
+    return entry.key_size == key_size && std::memcmp(entry.key, key, key_size) == 0;
+}
+
+// order of the versions of an extension
+template <typename VersionEntry>
+inline bool lessVersion(const VersionEntry& a, const VersionEntry& b) {
+    return a.semantic_version < b.semantic_version || (a.semantic_version == b.semantic_version && a.version < b.version);
+}
+
+inline std::uint64_t nameKey(std::uint32_t interface_id, std::uint32_t name_id) {
+    return static_cast<std::uint64_t>(interface_id) << 32U | name_id;
+}
 
-    const char* operator()(const char* first, const char* last) const {
-        // HINT: memmem is much slower than std::search
-        return std::search(first, last, _pattern_first, _pattern_last);
+// FNV-1a, the checksum of metadata built by EXTENSION_SYSTEM_METADATA
+std::uint64_t metadataChecksum(const char* data, std::size_t length, std::uint64_t hash = 14695981039346656037ULL) {
+    for (std::size_t i = 0; i < length; ++i) {
+        hash ^= static_cast<unsigned char>(data[i]);
+        hash *= 1099511628211ULL;
     }
+    return hash;
+}
+
+// little endian number of the binary metadata
+template <typename T>
+T readNumber(const char* data) {
+    T value{};
+    for (std::size_t i = sizeof(T); i > 0; --i)
+        value = static_cast<T>(static_cast<std::uint64_t>(value) << 8U | static_cast<unsigned char>(data[i - 1]));
+    return value;
+}
+
+std::size_t heapBytes(const std::string& str) {
+    static const std::size_t inline_capacity = std::string{}.capacity(); // small strings don't allocate
+    return str.capacity() > inline_capacity ? str.capacity() + 1 : 0;
+}
 
-private:
-    const char* _pattern_first;
-    const char* _pattern_last;
-};
-#endif
+template <typename HashTable>
+std::size_t heapBytes(const HashTable& table) {
+    // every node contains the value, the pointer to the next node and the cached hash
+    const std::size_t node_size = sizeof(typename HashTable::value_type) + sizeof(void*) + sizeof(std::size_t);
+    return table.bucket_count() * sizeof(void*) + table.size() * node_size;
+}
+
+std::string escapeLabel(const std::string& value) {
+    std::string result;
+    result.reserve(value.size());
+    for (const char c : value) {
+        if (c == '\\' || c == '"')
+            result += '\\';
+        if (c == '\n')
+            result += "\\n";
+        else
+            result += c;
+    }
+    return result;
+}
 
+void writeHistogram(std::ostream& out, const std::string& metric, const std::string& labels, const LatencyHistogram& histogram) {
+    if (histogram.count() == 0)
+        return;
+
+    static const std::pair<const char*, std::chrono::nanoseconds> bounds[] = {{"1e-06", std::chrono::microseconds{1}},
+                                                                              {"1e-05", std::chrono::microseconds{10}},
+                                                                              {"0.0001", std::chrono::microseconds{100}},
+                                                                              {"0.001", std::chrono::milliseconds{1}},
+                                                                              {"0.01", std::chrono::milliseconds{10}},
+                                                                              {"0.1", std::chrono::milliseconds{100}},
+                                                                              {"1", std::chrono::seconds{1}},
+                                                                              {"10", std::chrono::seconds{10}}};
+
+    for (const auto& bound : bounds) {
+        std::uint64_t count = 0;
+        histogram.forEachBucket([&](std::chrono::nanoseconds upper_bound, std::uint64_t c) {
+            if (upper_bound <= bound.second)
+                count += c;
+        });
+        out << metric << "_bucket{" << labels << ",le=\"" << bound.first << "\"} " << count << "\n";
+    }
+    out << metric << "_bucket{" << labels << ",le=\"+Inf\"} " << histogram.count() << "\n";
+    out << metric << "_sum{" << labels << "} " << std::chrono::duration<double>(histogram.sum()).count() << "\n";
+    out << metric << "_count{" << labels << "} " << histogram.count() << "\n";
+}
 } // namespace
 
-// boost broke compatibility
-// https://svn.boost.org/trac/boost/ticket/12552
-template <typename corpusIter>
-inline corpusIter getFirstFromPair(const std::pair<corpusIter, corpusIter>& p) {
-    return p.first;
+ExtensionDescription::ExtensionDescription(std::unordered_map<std::string, std::string>&& data,
+                                           ExtensionVersion                               version,
+                                           std::uint64_t                                  generation)
+    : m_version{version}
+    , m_generation{generation} {
+    if (data.empty())
+        return;
+
+    auto  arena   = std::make_shared<Arena>();
+    auto* entries = arena->allocateArray<Entry>(data.size());
+    auto* entry   = entries;
+    for (const auto& d : data) {
+        *entry++ = Entry{arena->copyString(d.first.data(), d.first.size()),
+                         static_cast<std::uint32_t>(d.first.size()),
+                         static_cast<std::uint32_t>(d.second.size()),
+                         arena->copyString(d.second.data(), d.second.size())};
+    }
+
+    m_arena       = std::move(arena);
+    m_entries     = entries;
+    m_entry_count = data.size();
 }
-template <typename corpusIter>
-inline corpusIter getFirstFromPair(corpusIter p) {
-    return p;
+
+std::unordered_map<std::string, std::string> ExtensionDescription::data() const {
+    std::unordered_map<std::string, std::string> result;
+    result.reserve(m_entry_count);
+    for (std::size_t i = 0; i < m_entry_count; ++i)
+        result.emplace(std::string{m_entries[i].key, m_entries[i].key_size}, std::string{m_entries[i].value, m_entries[i].value_size});
+    return result;
+}
+
+bool ExtensionDescription::operator==(const ExtensionDescription& desc) const {
+    if (m_version != desc.m_version || m_generation != desc.m_generation || m_entry_count != desc.m_entry_count)
+        return false;
+
+    if (m_entries == desc.m_entries)
+        return true; // copies share their entries
+
+    for (std::size_t i = 0; i < m_entry_count; ++i) {
+        const auto* other = desc.find(m_entries[i].key, m_entries[i].key_size);
+        if (other == nullptr || other->value_size != m_entries[i].value_size
+            || std::memcmp(other->value, m_entries[i].value, m_entries[i].value_size) != 0)
+            return false;
+    }
+    return true;
 }
 
 ExtensionSystem::ExtensionSystem()
@@ -73,171 +177,419 @@ ExtensionSystem::ExtensionSystem()
 ExtensionSystem::~ExtensionSystem() noexcept = default;
 
 std::size_t ExtensionSystem::addDynamicLibrary(const std::string& filename) {
+    filesystem::path_resolver resolver;
+    return addDynamicLibrary(filename, m_hot_reload, false, resolver);
+}
+
+std::size_t ExtensionSystem::addDynamicLibrary(const std::string&         filename,
+                                               bool                       reload_changed,
+                                               bool                       check_format,
+                                               filesystem::path_resolver& resolver) {
+    EXTENSION_SYSTEM_TRACE_SCOPE(add_span, "addDynamicLibrary", filename);
+    ScanJob job;
+    job.filename = filename;
+    openLibrary(job, resolver);
+    if (!needsScan(job, reload_changed))
+        return 0;
+
     std::vector<char> buffer;
-    return addDynamicLibrary(filename, buffer);
+    readLibrary(job, check_format, buffer);
+    return applyScan(job);
 }
 
-std::size_t ExtensionSystem::addDynamicLibrary(const std::string& filename, std::vector<char>& buffer) {
-    debugMessage("check file " + filename);
-    const std::string file_path = getRealFilename(filename);
+std::size_t ExtensionSystem::addDynamicLibraries(const std::vector<std::string>& filenames, bool reload_changed, bool check_format) {
+    // starting a thread costs about as much as reading a small cached library
+    const auto threads = std::min(m_scan_threads, (filenames.size() + 3) / 4);
+    // files found in the same directory share the resolution of the directory
+    filesystem::path_resolver resolver;
+    if (threads <= 1) {
+        std::size_t count = 0;
+        for (const auto& filename : filenames)
+            count += addDynamicLibrary(filename, reload_changed, check_format, resolver) != 0 ? 1 : 0;
+        return count;
+    }
 
-    if (file_path.empty()) {
-        m_message_handler("addDynamicLibrary: neither " + filename + " nor " + filename + DynamicLibrary::fileExtension() + " exist.");
-        return 0;
+    std::vector<ScanJob> jobs(filenames.size());
+    parallelFor(jobs.size(), threads, [&](std::size_t i) {
+        jobs[i].filename = filenames[i];
+        openLibrary(jobs[i], resolver);
+    });
+
+    // m_known_extensions is only accessed by this thread, the same file may be reachable by different names
+    std::vector<ScanJob*>           scans;
+    std::unordered_set<std::string> scanned_files;
+    for (auto& job : jobs) {
+        if (needsScan(job, reload_changed) && scanned_files.insert(job.file_path).second)
+            scans.push_back(&job);
     }
 
-    if (filesystem::is_directory(file_path)) {
-        m_message_handler("addDynamicLibrary: doesn't support adding directories directory=" + filename);
-        return 0;
+    parallelFor(scans.size(), threads, [&](std::size_t i) {
+        std::vector<char> buffer;
+        readLibrary(*scans[i], check_format, buffer);
+    });
+
+    std::size_t count = 0;
+    for (const auto* job : scans) {
+        EXTENSION_SYSTEM_TRACE_SCOPE(add_span, "addDynamicLibrary", job->filename);
+        count += applyScan(*job) != 0 ? 1 : 0;
     }
+    return count;
+}
 
-    auto already_loaded = m_known_extensions.find(file_path);
+void ExtensionSystem::openLibrary(ScanJob& job, filesystem::path_resolver& resolver) const {
+    EXTENSION_SYSTEM_TRACE_SCOPE(open_span, "open", job.filename);
+    const auto             start = std::chrono::steady_clock::now();
+    filesystem::file_stamp stamp;
+    job.file_path = getRealFilename(job.filename, resolver, stamp, job.is_directory);
 
-    // don't reload library
-    if (already_loaded != m_known_extensions.end())
-        return 0;
+    job.stamp.device            = stamp.device;
+    job.stamp.inode             = stamp.inode;
+    job.stamp.size              = stamp.size;
+    job.stamp.modification_time = stamp.modification_time;
 
-    std::size_t file_length{};
-    const char* file_content{};
-
-#ifdef EXTENSION_SYSTEM_USE_BOOST
-    (void)buffer;
-    const boost::interprocess::mode_t mode{boost::interprocess::read_only};
-    boost::interprocess::file_mapping fm;
-    try {
-        fm = boost::interprocess::file_mapping(file_path.c_str(), mode);
-    } catch (const boost::interprocess::interprocess_exception& e) {
-        m_message_handler(std::string("file_mapping failed ") + e.what());
-        return 0;
-    }
+    job.scan_time += std::chrono::steady_clock::now() - start;
+}
 
-    boost::interprocess::mapped_region file;
-    try {
-        file = boost::interprocess::mapped_region(fm, mode, 0, 0);
-    } catch (const boost::interprocess::interprocess_exception& e) {
-        m_message_handler(std::string("mapped_region failed ") + e.what());
-        return 0;
+bool ExtensionSystem::needsScan(const ScanJob& job, bool reload_changed) {
+    debugMessage("check file " + job.filename);
+
+    if (job.file_path.empty()) {
+        m_message_handler("addDynamicLibrary: neither " + job.filename + " nor " + job.filename + DynamicLibrary::fileExtension() + " exist.");
+        return false;
     }
 
-    file_length  = file.get_size();
-    file_content = reinterpret_cast<const char*>(file.get_address()); // NOLINT
-#else
-    {
-        std::ifstream file;
-        file.open(file_path, std::ios::in | std::ios::binary | std::ios::ate);
+    if (job.is_directory) {
+        m_message_handler("addDynamicLibrary: doesn't support adding directories directory=" + job.filename);
+        return false;
+    }
 
-        if (!file) {
-            m_message_handler("couldn't open file");
-            return 0;
-        }
+    auto already_loaded = m_known_extensions.find(job.file_path);
 
-        if (file.tellg() <= 0) {
-            m_message_handler("invalid or unknown file size");
-            return 0;
-        }
+    if (already_loaded != m_known_extensions.end()) {
+        // don't reload library
+        if (!reload_changed || equalStamps(already_loaded->second.stamp, job.stamp))
+            return false;
 
-        file_length = static_cast<std::size_t>(file.tellg());
-        file.seekg(0, std::ios::beg);
+        debugMessage("reload changed file " + job.file_path);
+        eraseLibrary(already_loaded);
+    }
 
-        if (buffer.size() < static_cast<std::size_t>(file_length))
-            buffer.resize(static_cast<std::size_t>(file_length));
+    return true;
+}
 
-        file_content = buffer.data();
+void ExtensionSystem::readLibrary(ScanJob& job, bool check_format, std::vector<char>& buffer) const {
+    const auto start = std::chrono::steady_clock::now();
 
-        file.read(buffer.data(), static_cast<std::streamsize>(file_length));
+    if (check_format && !DynamicLibrary::checkFileFormat(job.file_path, job.error)) {
+        job.ignored = true;
+        return;
     }
-#endif
 
-    return addExtensions(filename, file_content, file_length);
+    EXTENSION_SYSTEM_TRACE_SCOPE(read_span, "read", job.filename);
+    (void)readMetadataSections(job.file_path, desc_start, desc_end, m_scan_chunk_size, buffer, job.sections, job.error);
+    job.scan_time += std::chrono::steady_clock::now() - start;
 }
 
-std::size_t ExtensionSystem::addExtensions(const std::string& filename, const char* file_content, std::size_t file_length) {
-    StringSearch search_start(desc_start.c_str(), desc_start.c_str() + desc_start.length());
-    StringSearch search_end{desc_end.c_str(), desc_end.c_str() + desc_end.length()};
+std::size_t ExtensionSystem::applyScan(const ScanJob& job) {
+    if (job.ignored) {
+        debugMessage("ignore file " + job.file_path + " (" + job.error + ")");
+        return 0;
+    }
+
+    if (!job.error.empty()) {
+        m_message_handler(job.error);
+        return 0;
+    }
+
+    const auto start = std::chrono::steady_clock::now();
+    const auto count = addExtensions(job.filename, job.file_path, job.sections.data(), job.sections.size());
+
+    if (count != 0) {
+        m_known_extensions[job.file_path].stamp = job.stamp;
+        libraryLatencies(job.file_path)->scan.record(job.scan_time + (std::chrono::steady_clock::now() - start));
+    }
+
+    return count;
+}
 
-    const auto  file_path = getRealFilename(filename);
+std::size_t ExtensionSystem::addExtensions(const std::string& filename,
+                                           const std::string& file_path,
+                                           const char*        file_content,
+                                           std::size_t        file_length) {
     LibraryInfo info;
+    info.generation = ++m_generation;
+    info.arena      = std::make_shared<Arena>();
+    info.extensions = parseSections(filename, file_path, file_content, file_length, info.arena, info.generation);
 
-    const char* file_end = file_content + file_length;
-    for (const char* current = getFirstFromPair(search_start(file_content, file_end)); current != file_end;
-         current             = getFirstFromPair(search_start(current, file_end))) {
+    // still possible if the file has an invalid start tag
+    const auto count = info.extensions.size();
+
+    if (count == 0)
+        return 0;
 
-        const char* start = current;
+    m_known_extensions[file_path] = std::move(info);
+    addToIndex(file_path);
 
-        current         = getFirstFromPair(search_end(current + 1, file_end));
-        const char* end = current;
+    return count;
+}
 
-        if (end == file_end) { // end tag not found
+std::vector<ExtensionDescription> ExtensionSystem::parseSections(const std::string&            filename,
+                                                                 const std::string&            file_path,
+                                                                 const char*                   file_content,
+                                                                 std::size_t                   file_length,
+                                                                 const std::shared_ptr<Arena>& arena,
+                                                                 std::uint64_t                 generation) {
+    // the search span includes the nested parse spans
+    EXTENSION_SYSTEM_TRACE_SCOPE(search_span, "search", filename);
+
+    // all start and end tags are found in a single pass, the descriptions are located using the list of tags
+    const MarkerScanner                scanner{desc_start, desc_end};
+    std::vector<MarkerScanner::Marker> markers;
+    scanner.findAll(file_content, file_content + file_length, markers);
+
+    // shared by all descriptions of the library
+    const ExtensionDescription::Entry library_filename{"library_filename",
+                                                       16,
+                                                       static_cast<std::uint32_t>(file_path.size()),
+                                                       arena->copyString(file_path.data(), file_path.size())};
+    std::vector<ExtensionDescription::Entry> entries;
+    std::vector<ExtensionDescription>        result;
+
+    for (auto marker = markers.begin(); marker != markers.end(); ++marker) {
+        if (marker->kind != MarkerScanner::Kind::Start)
+            continue; // end tag without start tag
+
+        const auto end_marker = std::find_if(
+            marker + 1, markers.end(), [](const MarkerScanner::Marker& m) { return m.kind == MarkerScanner::Kind::End; });
+
+        if (end_marker == markers.end()) {
             m_message_handler("addDynamicLibrary: filename=" + filename + " end tag was missing");
             break;
         }
 
-        // check if there is a start tag before the end search the next start tag and check if it is interleaved with current section
-        if (getFirstFromPair(search_start(start + 1, end)) < end) {
+        const char* start       = marker->position;
+        const char* end         = end_marker->position;
+        const bool  interleaved = end_marker != marker + 1;
+        marker                  = end_marker;
+
+        // another start tag before the end tag
+        if (interleaved) {
             m_message_handler("addDynamicLibrary: filename=" + filename + " found a start tag before the expected end tag");
             continue;
         }
 
-        auto key_value = parseKeyValue(filename, start, end);
+        EXTENSION_SYSTEM_TRACE_SCOPE(parse_span, "parse", filename);
+        bool             verified{};
+        ExtensionVersion encoded_version{};
+        const bool       binary = isBinaryMetadata(start, end);
+        if (binary ? !parseBinaryEntries(filename, start, end, entries, encoded_version, verified)
+                   : !parseKeyValue(filename, start, end, entries))
+            continue; // invalid export
 
-        if (key_value.empty())
-            continue; // empty or invalid export
+        auto ext = parse(filename, entries, arena, library_filename, generation, binary && verified ? &encoded_version : nullptr);
 
-        key_value["library_filename"] = file_path;
+        if (ext.isValid())
+            result.push_back(std::move(ext));
+    }
+
+    return result;
+}
 
-        auto ext = parse(filename, std::move(key_value));
+std::vector<ExtensionDescription> ExtensionSystem::probeLibrary(const std::string& filename) {
+    EXTENSION_SYSTEM_TRACE_SCOPE(probe_span, "probeLibrary", filename);
+    filesystem::path_resolver resolver;
+    ScanJob                   job;
+    job.filename = filename;
+    openLibrary(job, resolver);
 
-        if (ext.isValid())
-            info.extensions.push_back(std::move(ext));
+    if (job.file_path.empty()) {
+        m_message_handler("probeLibrary: neither " + filename + " nor " + filename + DynamicLibrary::fileExtension() + " exist.");
+        return {};
     }
 
-    // still possible if the file has an invalid start tag
-    const auto count = info.extensions.size();
+    if (job.is_directory) {
+        m_message_handler("probeLibrary: doesn't support directories directory=" + filename);
+        return {};
+    }
 
-    if (count == 0)
-        return 0;
+    // added libraries that didn't change since they were scanned aren't read again
+    const auto known = m_known_extensions.find(job.file_path);
+    if (known != m_known_extensions.end() && equalStamps(known->second.stamp, job.stamp)) {
+        debugMessage("probe cached file " + job.file_path);
+        return known->second.extensions;
+    }
 
-    m_known_extensions[file_path] = std::move(info);
+    if (!DynamicLibrary::checkFileFormat(job.file_path, job.error)) {
+        debugMessage("ignore file " + job.file_path + " (" + job.error + ")");
+        return {};
+    }
 
-    return count;
+    // descriptions are placed in the read-only data of ELF files, code and debug information are skipped
+    // the whole file is searched if it isn't an ELF file or nothing was found, e.g. because of unusual section headers
+    std::vector<FileRange> ranges;
+    std::vector<char>      buffer;
+    bool                   read{};
+    if (findReadOnlyDataSections(job.file_path, ranges))
+        read = readMetadataSections(job.file_path, ranges, desc_start, desc_end, m_scan_chunk_size, buffer, job.sections, job.error);
+    if (!read || job.sections.empty()) {
+        job.sections.clear();
+        job.error.clear();
+        read = readMetadataSections(job.file_path, desc_start, desc_end, m_scan_chunk_size, buffer, job.sections, job.error);
+    }
+    if (!read) {
+        m_message_handler("probeLibrary: " + job.error);
+        return {};
+    }
+
+    return parseSections(filename, job.file_path, job.sections.data(), job.sections.size(), std::make_shared<Arena>(), 0);
 }
 
-std::unordered_map<std::string, std::string> ExtensionSystem::parseKeyValue(const std::string& filename, const char* start, const char* end) {
-    std::unordered_map<std::string, std::string> result;
+bool ExtensionSystem::parseKeyValue(const std::string&                        filename,
+                                    const char*                               start,
+                                    const char*                               end,
+                                    std::vector<ExtensionDescription::Entry>& result) {
+    result.clear();
+
+    // key=value pairs separated by '\0', the last pair is terminated by the '\0' in front of the end tag
+    const char* last = end - 1;
+    for (const char* token = start;; ++token) {
+        const char* token_end = std::find(token, last, '\0');
+        const char* separator = std::find(token, token_end, '=');
+        if (separator == token_end) {
+            m_message_handler("addDynamicLibrary: filename=" + filename + " '=' is missing (" + std::string{token, token_end} // NOLINT
+                              + "), ignore extension export");
+            return false;
+        }
+
+        const ExtensionDescription::Entry entry{token,
+                                                static_cast<std::uint32_t>(separator - token),
+                                                static_cast<std::uint32_t>(token_end - separator - 1),
+                                                separator + 1};
+
+        for (const auto& e : result) {
+            if (hasKey(e, entry.key, entry.key_size)) {
+                m_message_handler("addDynamicLibrary: filename=" + filename + " duplicate key (" // NOLINT
+                                  + std::string{entry.key, entry.key_size} + ") found, ignore extension export");
+                return false;
+            }
+        }
+
+        result.push_back(entry);
+
+        if (token_end == last)
+            return true;
+        token = token_end;
+    }
+}
+
+bool ExtensionSystem::isBinaryMetadata(const char* start, const char* end) const {
+    // start entry with the value EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY
+    const auto start_size = desc_start.length();
+    return static_cast<std::size_t>(end - start) >= start_size + 3 && start[start_size] == '='
+           && start[start_size + 1] == EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_BINARY[0] && start[start_size + 2] == '\0';
+}
+
+bool ExtensionSystem::parseBinaryEntries(const std::string&                        filename,
+                                         const char*                               start,
+                                         const char*                               end,
+                                         std::vector<ExtensionDescription::Entry>& result,
+                                         ExtensionVersion&                         version,
+                                         bool&                                     verified) {
+    using detail::binary_metadata_header_size;
+    using detail::binary_metadata_magic;
+
+    // start entry, header and entries, see EXTENSION_SYSTEM_METADATA
+    const char* header  = start + desc_start.length() + 3;
+    const char* entries = header + binary_metadata_header_size;
+    if (end - header < static_cast<std::ptrdiff_t>(binary_metadata_header_size)
+        || std::memcmp(header, binary_metadata_magic, sizeof(binary_metadata_magic) - 1) != 0
+        || readNumber<std::uint16_t>(header + 4) != EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY
+        || readNumber<std::uint32_t>(header + 8) != static_cast<std::uint64_t>(end - entries)) {
+        m_message_handler("addDynamicLibrary: filename=" + filename + " invalid binary metadata header, ignore extension export");
+        return false;
+    }
 
-    bool successful = split({start, end - 1}, '\0', [&](const std::string& iter) {
-        const auto pos = iter.find('=');
-        if (pos == std::string::npos) {
-            m_message_handler("addDynamicLibrary: filename=" + filename + " '=' is missing (" + iter + "), ignore extension export"); // NOLINT
+    const auto count       = readNumber<std::uint16_t>(header + 6);
+    const auto header_hash = metadataChecksum(header, binary_metadata_header_size - 8);
+    version                = readNumber<std::uint32_t>(header + 12);
+    verified               = metadataChecksum(entries, static_cast<std::size_t>(end - entries), header_hash)
+               == readNumber<std::uint64_t>(header + binary_metadata_header_size - 8);
+
+    result.clear();
+    result.push_back(
+        ExtensionDescription::Entry{start, static_cast<std::uint32_t>(desc_start.length()), 1, start + desc_start.length() + 1});
+    for (const char* entry = entries; entry != end;) {
+        // the lengths are checked even if the checksum matched, a wrong length must not lead out of the metadata
+        if (end - entry < 2 || end - entry - 2 < readNumber<std::uint16_t>(entry) + 4) {
+            m_message_handler("addDynamicLibrary: filename=" + filename + " binary metadata is truncated, ignore extension export");
             return false;
         }
-        const auto key   = iter.substr(0, pos);
-        const auto value = iter.substr(pos + 1);
-        if (result.find(key) != result.end()) {
-            m_message_handler("addDynamicLibrary: filename=" + filename + " duplicate key (" + key + ") found, ignore extension export"); // NOLINT
+        const auto  key_size   = readNumber<std::uint16_t>(entry);
+        const char* key        = entry + 2;
+        const auto  value_size = readNumber<std::uint32_t>(key + key_size);
+        const char* value      = key + key_size + 4;
+        if (static_cast<std::uint64_t>(end - value) < value_size) {
+            m_message_handler("addDynamicLibrary: filename=" + filename + " binary metadata is truncated, ignore extension export");
             return false;
         }
-        result[key] = value;
-        return true;
-    });
 
-    if (successful && result.empty())
-        m_message_handler("addDynamicLibrary: filename=" + filename + " metadata description didn't contain any data, ignore it");
+        const ExtensionDescription::Entry e{key, key_size, value_size, value};
+        // compile time checks guarantee unique keys, without matching checksum they have to be checked
+        if (!verified) {
+            for (const auto& other : result) {
+                if (hasKey(other, e.key, e.key_size)) {
+                    m_message_handler("addDynamicLibrary: filename=" + filename + " duplicate key (" // NOLINT
+                                      + std::string{e.key, e.key_size} + ") found, ignore extension export");
+                    return false;
+                }
+            }
+        }
+        result.push_back(e);
+        entry = value + value_size;
+    }
 
-    return result;
+    if (result.size() != static_cast<std::size_t>(count) + 1) {
+        m_message_handler("addDynamicLibrary: filename=" + filename
+                          + " binary metadata has an unexpected number of entries, ignore extension export");
+        return false;
+    }
+    return true;
 }
 
-ExtensionDescription ExtensionSystem::parse(const std::string& filename, std::unordered_map<std::string, std::string>&& desc) {
+ExtensionDescription ExtensionSystem::parse(const std::string&                              filename,
+                                            const std::vector<ExtensionDescription::Entry>& entries,
+                                            const std::shared_ptr<Arena>&                   arena,
+                                            const ExtensionDescription::Entry&              library_filename,
+                                            std::uint64_t                                   generation,
+                                            const ExtensionVersion*                         encoded_version) {
+    const auto find = [&](const std::string& key) -> const ExtensionDescription::Entry* {
+        for (const auto& e : entries)
+            if (hasKey(e, key.data(), key.size()))
+                return &e;
+        return nullptr;
+    };
+
+    const auto value = [&](const std::string& key) -> std::string {
+        const auto* entry = find(key);
+        if (entry == nullptr)
+            return {};
+        return {entry->value, entry->value_size};
+    };
+
+    const auto api_version = value(desc_start);
     if (m_verify_compiler
-        && (desc[desc_start] != EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR || desc["compiler"] != EXTENSION_SYSTEM_COMPILER
-            || desc["compiler_version"] != EXTENSION_SYSTEM_COMPILER_VERSION_STR || desc["build_type"] != EXTENSION_SYSTEM_BUILD_TYPE)) {
+        && ((api_version != EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_TEXT
+             && api_version != EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_BINARY)
+            || value("compiler") != EXTENSION_SYSTEM_COMPILER
+            || value("compiler_version") != EXTENSION_SYSTEM_COMPILER_VERSION_STR || value("build_type") != EXTENSION_SYSTEM_BUILD_TYPE)) {
         // clang-format off
             m_message_handler("addDynamicLibrary: Ignore file " + filename + ". Compilation options didn't match or were invalid ("
-                               "version="           + desc[desc_start]
-                             + " compiler="         + desc["compiler"]
-                             + " compiler_version=" + desc["compiler_version"]
-                             + " build_type="       + desc["build_type"]
-                             + " expected version=" EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR
+                               "version="           + api_version
+                             + " compiler="         + value("compiler")
+                             + " compiler_version=" + value("compiler_version")
+                             + " build_type="       + value("build_type")
+                             + " expected version=" EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_TEXT
+                             " or "                 EXTENSION_SYSTEM_EXTENSION_API_VERSION_STR_BINARY
                              " compiler="           EXTENSION_SYSTEM_COMPILER
                              " compiler_version="   EXTENSION_SYSTEM_COMPILER_VERSION_STR
                              " build_type="         EXTENSION_SYSTEM_BUILD_TYPE
@@ -249,13 +601,13 @@ ExtensionDescription ExtensionSystem::parse(const std::string& filename, std::un
     std::string name;
 
     const auto is_invalid = [&](const std::string& str) {
-        const auto iter = desc.find(str);
-        if (iter == desc.end()) {
+        const auto* entry = find(str);
+        if (entry == nullptr) {
             m_message_handler("addDynamicLibrary: filename=" + filename + " " + name + str + " has to be set"); // NOLINT
             return true;
         }
 
-        if (iter->second.empty()) {
+        if (entry->value_size == 0) {
             m_message_handler("addDynamicLibrary: filename=" + filename + " " + name + str + " can not be empty"); // NOLINT
             return true;
         }
@@ -266,7 +618,7 @@ ExtensionDescription ExtensionSystem::parse(const std::string& filename, std::un
     if (is_invalid("name"))
         return {};
 
-    name = "name= " + desc.at("name");
+    name = "name= " + value("name");
 
     if (is_invalid("interface_name"))
         return {};
@@ -279,58 +631,561 @@ ExtensionDescription ExtensionSystem::parse(const std::string& filename, std::un
 
     ExtensionVersion version{};
 
-    std::stringstream str{desc.at("version")};
-    str >> version;
+    if (encoded_version != nullptr) {
+        version = *encoded_version;
+    } else {
+        std::stringstream str{value("version")};
+        str >> version;
 
-    if (str.fail()) {
-        m_message_handler("addDynamicLibrary: filename=" + filename + " " + name + " couldn't parse version"); // NOLINT
+        if (str.fail()) {
+            m_message_handler("addDynamicLibrary: filename=" + filename + " " + name + " couldn't parse version"); // NOLINT
+            return {};
+        }
+    }
+
+    SemanticVersion semantic_version{};
+    const auto*     semantic_entry = find("semantic_version");
+    if (semantic_entry != nullptr && !SemanticVersion::parse(semantic_entry->value, semantic_entry->value_size, semantic_version)) {
+        m_message_handler("addDynamicLibrary: filename=" + filename + " " + name + " couldn't parse semantic_version"); // NOLINT
         return {};
     }
 
-    desc.erase(desc_start);
+    // copy the entries into the arena, the start tag is dropped and library_filename is set by the ExtensionSystem
+    const auto is_copied = [&](const ExtensionDescription::Entry& e) {
+        return !hasKey(e, desc_start.data(), desc_start.size()) && !hasKey(e, library_filename.key, library_filename.key_size);
+    };
+
+    const auto count  = static_cast<std::size_t>(std::count_if(entries.begin(), entries.end(), is_copied)) + 1;
+    auto*      result = arena->allocateArray<ExtensionDescription::Entry>(count);
+    auto*      entry  = result;
+    for (const auto& e : entries) {
+        if (is_copied(e))
+            *entry++ = ExtensionDescription::Entry{arena->copyString(e.key, e.key_size), e.key_size, e.value_size, arena->copyString(e.value, e.value_size)};
+    }
+    *entry = library_filename;
 
-    return ExtensionDescription{std::move(desc), version};
+    return ExtensionDescription{arena, result, count, version, generation};
 }
 
 void ExtensionSystem::removeDynamicLibrary(const std::string& filename) {
-    const auto real_filename = getRealFilename(filename);
+    EXTENSION_SYSTEM_TRACE_SCOPE(remove_span, "removeDynamicLibrary", filename);
+    filesystem::path_resolver resolver;
+    filesystem::file_stamp    stamp;
+    bool                      is_directory{};
+    auto                      real_filename = getRealFilename(filename, resolver, stamp, is_directory);
+    if (real_filename.empty())
+        real_filename = getDeletedFilename(filename, resolver);
     const auto iter          = m_known_extensions.find(real_filename);
-    if (iter != m_known_extensions.end())
-        m_known_extensions.erase(iter);
+    if (iter == m_known_extensions.end())
+        return;
+
+    eraseLibrary(iter);
+}
+
+void ExtensionSystem::eraseLibrary(std::unordered_map<std::string, LibraryInfo>::iterator iter) {
+    removeFromIndex(iter->first);
+    detachLibrary(iter->second);
+    m_known_extensions.erase(iter);
+}
+
+void ExtensionSystem::detachLibrary(const LibraryInfo& info) {
+    // keep track of the library until the last extension created from it is freed
+    m_detached_libraries.erase(std::remove_if(m_detached_libraries.begin(),
+                                              m_detached_libraries.end(),
+                                              [](const std::weak_ptr<LoadedLibrary>& l) { return l.expired(); }),
+                               m_detached_libraries.end());
+    if (!info.library.expired())
+        m_detached_libraries.push_back(info.library);
+}
+
+std::size_t ExtensionSystem::reloadChangedLibraries() {
+    std::vector<std::string> files;
+    files.reserve(m_known_extensions.size());
+    for (const auto& i : m_known_extensions)
+        files.push_back(i.first);
+
+    std::size_t              count = 0;
+    std::vector<std::string> changed;
+    for (const auto& file : files) {
+        filesystem::file_stamp stamp;
+        if (!filesystem::get_file_stamp(file, stamp)) {
+            debugMessage("remove vanished file " + file);
+            eraseLibrary(m_known_extensions.find(file));
+            ++count;
+            continue;
+        }
+
+        if (equalStamps(m_known_extensions.at(file).stamp, stamp))
+            continue;
+
+        changed.push_back(file);
+        ++count;
+    }
+
+    (void)addDynamicLibraries(changed, true, false);
+    return count;
+}
+
+ExtensionSystem::LoadedLibrary::~LoadedLibrary() {
+    if (copy_path.empty())
+        return;
+    library = DynamicLibrary{}; // unloaded before the copy is removed, Windows doesn't allow removing loaded libraries
+    (void)filesystem::remove_private_copy(copy_path);
+}
+
+std::shared_ptr<ExtensionSystem::LoadedLibrary> ExtensionSystem::loadLibrary(const ExtensionDescription& desc) {
+    if (m_unload_policy == UnloadPolicy::IdleTimeout)
+        unloadIdleLibraries();
+
+    const auto iter = m_known_extensions.find(desc.library_filename());
+    if (iter == m_known_extensions.end())
+        return {};
+
+    auto& info = iter->second;
+    if (std::find(info.extensions.begin(), info.extensions.end(), desc) == info.extensions.end())
+        return {};
+
+    auto library = info.library.lock();
+    if (library == nullptr) {
+        EXTENSION_SYSTEM_TRACE_SCOPE(dlopen_span, "dlopen", iter->first);
+        // The dynamic loader identifies libraries by their path, loading a changed file again would return the old library.
+        // A copy in a private directory is loaded instead, it is removed after the library was unloaded. Changed files are also
+        // re-scanned without hot reload (reloadChangedLibraries, processDirectoryChanges), so this doesn't depend on m_hot_reload.
+        const auto  loaded = m_loaded_files.find(iter->first);
+        std::string copy_path;
+        if (loaded != m_loaded_files.end() && !equalStamps(loaded->second, info.stamp)) {
+            copy_path = filesystem::make_private_copy(iter->first).string();
+            if (copy_path.empty()) {
+                m_message_handler("createExtension: couldn't copy " + iter->first + " to a temporary directory");
+                return {};
+            }
+        }
+
+        const auto dlopen_start = std::chrono::steady_clock::now();
+        library                 = std::make_shared<LoadedLibrary>(iter->first,
+                                                  std::move(copy_path),
+                                                  m_unload_policy != UnloadPolicy::Never,
+                                                  m_link_namespace,
+                                                  info.generation,
+                                                  libraryLatencies(iter->first));
+        const auto dlopen_time = std::chrono::steady_clock::now() - dlopen_start;
+
+        if (!library->library.isValid()) {
+            m_message_handler("createExtension: " + library->library.getError());
+            return {};
+        }
+        if (library->library.getLinkNamespace() != m_link_namespace)
+            m_message_handler("createExtension: no isolated link namespace available, loaded " + iter->first + " into the global namespace");
+
+        library->latencies->dlopen.record(dlopen_time);
+        extensionRecord(desc)->latencies.dlopen.record(dlopen_time);
+
+        if (library->copy_path.empty())
+            m_loaded_files[iter->first] = info.stamp;
+        info.library = library;
+    }
+
+    if (m_unload_policy != UnloadPolicy::Immediate)
+        info.pinned = library;
+
+    return library;
+}
+
+void ExtensionSystem::setUnloadPolicy(UnloadPolicy policy, std::chrono::milliseconds idle_timeout) {
+    m_unload_policy = policy;
+    m_idle_timeout  = idle_timeout;
+    unloadIdleLibraries();
+}
+
+std::size_t ExtensionSystem::unloadIdleLibraries() {
+    if (m_unload_policy == UnloadPolicy::Never)
+        return 0;
+
+    const auto now     = std::chrono::steady_clock::now().time_since_epoch();
+    const auto timeout = std::chrono::duration_cast<std::chrono::steady_clock::duration>(m_idle_timeout);
+
+    std::size_t count = 0;
+    for (auto& i : m_known_extensions) {
+        auto& pinned = i.second.pinned;
+        if (pinned == nullptr || pinned->live_instances != 0)
+            continue;
+
+        const std::chrono::steady_clock::duration last_release{pinned->last_release.load()};
+        if (m_unload_policy == UnloadPolicy::Immediate || now - last_release >= timeout) {
+            debugMessage("unload library " + i.first);
+            pinned.reset();
+            ++count;
+        }
+    }
+
+    return count;
+}
+
+std::vector<LibraryUsage> ExtensionSystem::loadedLibraries() const {
+    std::vector<LibraryUsage> result;
+
+    for (const auto& i : m_known_extensions) {
+        const auto library = i.second.library.lock();
+        if (library != nullptr)
+            result.push_back({i.first, library->generation, library->live_instances, i.second.pinned != nullptr, true});
+    }
+
+    for (const auto& i : m_detached_libraries) {
+        const auto library = i.lock();
+        if (library != nullptr)
+            result.push_back({library->filename, library->generation, library->live_instances, false, false});
+    }
+
+    return result;
+}
+
+std::shared_ptr<LatencyHistograms> ExtensionSystem::libraryLatencies(const std::string& filename) {
+    auto& latencies = m_library_latencies[filename];
+    if (latencies == nullptr)
+        latencies = std::make_shared<LatencyHistograms>();
+    return latencies;
+}
+
+std::shared_ptr<ExtensionSystem::ExtensionRecord> ExtensionSystem::extensionRecord(const ExtensionDescription& desc) {
+    auto& record = m_extension_records[ExtensionKey{desc.library_filename(), desc.interface_name(), desc.name(), desc.version()}];
+    if (record == nullptr)
+        record = std::make_shared<ExtensionRecord>();
+    return record;
+}
+
+MemoryUsage ExtensionSystem::memoryUsage() const {
+    MemoryUsage result;
+    result.indexes = heapBytes(m_known_extensions) + heapBytes(m_string_ids);
+    for (const auto& i : m_string_ids)
+        result.indexes += heapBytes(i.first);
+    result.indexes += m_index.interface_ids.capacity() * sizeof(std::uint32_t) + m_index.name_ids.capacity() * sizeof(std::uint32_t)
+                      + m_index.versions.capacity() * sizeof(ExtensionVersion) + m_index.library_ids.capacity() * sizeof(std::uint32_t)
+                      + m_index.entry_point_ids.capacity() * sizeof(std::uint32_t)
+                      + m_index.descriptions.capacity() * sizeof(const ExtensionDescription*) + heapBytes(m_index.versions_by_name);
+    for (const auto& i : m_index.versions_by_name)
+        result.indexes += i.second.capacity() * sizeof(VersionEntry);
+    result.libraries.reserve(m_known_extensions.size());
+
+    for (const auto& i : m_known_extensions) {
+        result.indexes += heapBytes(i.first);
+
+        MemoryUsage::Library library;
+        library.filename     = i.first;
+        library.descriptions = i.second.extensions.capacity() * sizeof(ExtensionDescription);
+        for (const auto& desc : i.second.extensions)
+            library.description_maps += desc.m_entry_count * sizeof(ExtensionDescription::Entry);
+        if (i.second.arena != nullptr) {
+            library.metadata_strings = i.second.arena->used() - library.description_maps;
+            library.unused           = i.second.arena->reserved() - i.second.arena->used();
+        }
+
+        result.descriptions += library.descriptions;
+        result.description_maps += library.description_maps;
+        result.metadata_strings += library.metadata_strings;
+        result.unused += library.unused;
+        result.libraries.push_back(std::move(library));
+    }
+
+    return result;
+}
+
+std::vector<ExtensionUsage> ExtensionSystem::extensionUsage() const {
+    std::vector<ExtensionUsage> result;
+    for (const auto& i : m_extension_records) {
+        const auto& record = *i.second;
+        if (record.created == 0)
+            continue; // only loaded, e.g. the constructor failed
+        result.push_back({std::get<0>(i.first),
+                          std::get<1>(i.first),
+                          std::get<2>(i.first),
+                          std::get<3>(i.first),
+                          record.live_instances,
+                          record.peak_instances,
+                          record.created});
+    }
+    return result;
+}
+
+void ExtensionSystem::resetPeakInstances() {
+    for (auto& i : m_extension_records)
+        i.second->peak_instances = i.second->live_instances.load();
+}
+
+std::vector<LatencyStatistics> ExtensionSystem::latencies() const {
+    std::vector<LatencyStatistics> result;
+    result.reserve(m_library_latencies.size() + m_extension_records.size());
+
+    for (const auto& i : m_library_latencies)
+        result.push_back({i.first, {}, {}, 0, i.second});
+
+    for (const auto& i : m_extension_records) {
+        const std::shared_ptr<const LatencyHistograms> histograms{i.second, &i.second->latencies};
+        result.push_back({std::get<0>(i.first), std::get<1>(i.first), std::get<2>(i.first), std::get<3>(i.first), histograms});
+    }
+
+    return result;
+}
+
+std::string ExtensionSystem::latencyMetrics() const {
+    std::ostringstream out;
+    out.precision(9);
+
+    const std::pair<const char*, const char*> operations[] = {{"scan", "Time to read and parse a library"},
+                                                              {"dlopen", "Time to load a library"},
+                                                              {"construct", "Time to create an extension"},
+                                                              {"destroy", "Time to free an extension"}};
+
+    const auto histogram = [](const LatencyHistograms& h, const std::string& operation) -> const LatencyHistogram& {
+        if (operation == "scan")
+            return h.scan;
+        if (operation == "dlopen")
+            return h.dlopen;
+        if (operation == "construct")
+            return h.construct;
+        return h.destroy;
+    };
+
+    for (const auto& operation : operations) {
+        const std::string metric = std::string{"extension_system_library_"} + operation.first + "_seconds";
+        out << "# HELP " << metric << " " << operation.second << "\n";
+        out << "# TYPE " << metric << " histogram\n";
+        for (const auto& i : m_library_latencies)
+            writeHistogram(out, metric, "library=\"" + escapeLabel(i.first) + "\"", histogram(*i.second, operation.first));
+    }
+
+    for (const auto& operation : operations) {
+        if (std::string{operation.first} == "scan")
+            continue; // scans are only recorded per library
+        const std::string metric = std::string{"extension_system_extension_"} + operation.first + "_seconds";
+        out << "# HELP " << metric << " " << operation.second << "\n";
+        out << "# TYPE " << metric << " histogram\n";
+        for (const auto& i : m_extension_records) {
+            const auto labels = "library=\"" + escapeLabel(std::get<0>(i.first)) + "\",interface=\"" + escapeLabel(std::get<1>(i.first))
+                                + "\",name=\"" + escapeLabel(std::get<2>(i.first)) + "\",version=\"" + std::to_string(std::get<3>(i.first))
+                                + "\"";
+            writeHistogram(out, metric, labels, histogram(i.second->latencies, operation.first));
+        }
+    }
+
+    return out.str();
+}
+
+void ExtensionSystem::resetLatencies() {
+    const auto reset = [](LatencyHistograms& h) {
+        h.scan.reset();
+        h.dlopen.reset();
+        h.construct.reset();
+        h.destroy.reset();
+    };
+    for (auto& i : m_library_latencies)
+        reset(*i.second);
+    for (auto& i : m_extension_records)
+        reset(i.second->latencies);
 }
 
 void ExtensionSystem::searchDirectory(const std::string& path, bool recursive) {
+    EXTENSION_SYSTEM_TRACE_SCOPE(search_span, "searchDirectory", path);
     debugMessage("search directory path=" + path + " recursive=" + (recursive ? "true" : "false"));
-    std::vector<char> buffer;
+    watchDirectory(path, {}, recursive);
+    std::vector<std::string> files;
     filesystem::forEachFileInDirectory(
         path,
-        [this, &buffer](const filesystem::path& p) {
+        [this, &files](const filesystem::path& p) {
             if (p.extension().string() == DynamicLibrary::fileExtension())
-                addDynamicLibrary(p.string(), buffer);
+                files.push_back(p.string());
             else
                 debugMessage("ignore file " + p.string() + " due to wrong fileExtension (" + DynamicLibrary::fileExtension() + ")");
         },
         recursive);
+    (void)addDynamicLibraries(files, m_hot_reload, m_check_file_format);
 }
 
 void ExtensionSystem::searchDirectory(const std::string& path, const std::string& required_prefix, bool recursive) {
+    EXTENSION_SYSTEM_TRACE_SCOPE(search_span, "searchDirectory", path);
     debugMessage("search directory path=" + path + "required_prefix=" + required_prefix + " recursive=" + (recursive ? "true" : "false"));
-    std::vector<char> buffer;
-    const std::size_t required_prefix_length = required_prefix.length();
+    watchDirectory(path, required_prefix, recursive);
+    std::vector<std::string> files;
+    const std::size_t        required_prefix_length = required_prefix.length();
     filesystem::forEachFileInDirectory(
         path,
-        [this, &buffer, required_prefix_length, &required_prefix](const filesystem::path& p) {
+        [this, &files, required_prefix_length, &required_prefix](const filesystem::path& p) {
             if (p.extension().string() == DynamicLibrary::fileExtension()
                 && p.filename().string().compare(0, required_prefix_length, required_prefix) == 0)
-                addDynamicLibrary(p.string(), buffer);
+                files.push_back(p.string());
             else
                 debugMessage("ignore file " + p.string() + " either due to wrong required_prefix or wrong fileExtension ("
                              + p.extension().string() + ")");
         },
         recursive);
+    (void)addDynamicLibraries(files, m_hot_reload, m_check_file_format);
+}
+
+void ExtensionSystem::searchDirectory(const std::string& path, const DirectoryFilter& filter) {
+    EXTENSION_SYSTEM_TRACE_SCOPE(search_span, "searchDirectory", path);
+    debugMessage("search directory path=" + path + " max_depth=" + std::to_string(filter.maxDepth()));
+    watchDirectory(path, filter);
+    std::vector<std::string> files;
+    filesystem::forEachFileInDirectory(
+        path,
+        [&filter](const char* name, std::size_t length, bool is_directory) {
+            return is_directory ? filter.matchesDirectory(name, length) : filter.matchesFile(name, length);
+        },
+        [&files](const filesystem::path& p) { files.push_back(p.string()); },
+        filter.maxDepth());
+    (void)addDynamicLibraries(files, m_hot_reload, m_check_file_format);
+}
+
+void ExtensionSystem::setEnableDirectoryWatch(bool enable) {
+    if (!enable)
+        m_watcher.reset();
+    else if (m_watcher == nullptr)
+        m_watcher.reset(new DirectoryWatcher);
+}
+
+void ExtensionSystem::watchDirectory(const std::string& path, const std::string& required_prefix, bool recursive) {
+    if (m_watcher == nullptr)
+        return;
+
+    m_watcher->watch(path, recursive, [required_prefix](const filesystem::path& p) {
+        return p.extension().string() == DynamicLibrary::fileExtension()
+               && p.filename().string().compare(0, required_prefix.length(), required_prefix) == 0;
+    });
+}
+
+void ExtensionSystem::watchDirectory(const std::string& path, const DirectoryFilter& filter) {
+    if (m_watcher == nullptr)
+        return;
+
+    // excluded directories and directories below the maximum depth are neither watched nor rescanned, matchesPath checks the
+    // part of the name below path
+    m_watcher->watch(
+        path,
+        filter.maxDepth(),
+        [path, filter](const filesystem::path& p) {
+            const auto name = p.string();
+            return name.compare(0, path.length(), path) == 0 && filter.matchesPath(name.substr(path.length()));
+        },
+        [filter](const char* name, std::size_t length) { return filter.matchesDirectory(name, length); });
+}
+
+std::size_t ExtensionSystem::processDirectoryChanges(std::chrono::milliseconds settle_time) {
+    if (m_watcher == nullptr)
+        return 0;
+
+    const auto changes = m_watcher->changes(settle_time);
+
+    if (changes.overflow) {
+        m_message_handler("processDirectoryChanges: lost directory change events, rescan all watched directories");
+        auto                     count = reloadChangedLibraries();
+        std::vector<std::string> files;
+        m_watcher->forEachWatchedFile([&](const filesystem::path& p) { files.push_back(p.string()); });
+        return count + addDynamicLibraries(files, true, m_check_file_format);
+    }
+
+    std::vector<std::string> files;
+    for (const auto& file : changes.files) {
+        if (filesystem::exists(file)) {
+            debugMessage("directory watch: add or update " + file);
+            files.push_back(file);
+        } else {
+            debugMessage("directory watch: remove " + file);
+            removeDynamicLibrary(file);
+        }
+    }
+    (void)addDynamicLibraries(files, true, m_check_file_format);
+
+    return changes.files.size();
+}
+
+std::uint32_t ExtensionSystem::internString(const std::string& str) {
+    return m_string_ids.emplace(str, static_cast<std::uint32_t>(m_string_ids.size())).first->second;
+}
+
+bool ExtensionSystem::findStringId(const std::string& str, std::uint32_t& id) const {
+    const auto iter = m_string_ids.find(str);
+    if (iter == m_string_ids.end())
+        return false;
+    id = iter->second;
+    return true;
+}
+
+const std::vector<std::uint32_t>* ExtensionSystem::indexColumn(const std::string& key) const {
+    if (key == "interface_name")
+        return &m_index.interface_ids;
+    if (key == "name")
+        return &m_index.name_ids;
+    if (key == "library_filename")
+        return &m_index.library_ids;
+    if (key == "entry_point")
+        return &m_index.entry_point_ids;
+    return nullptr;
+}
+
+void ExtensionSystem::addToIndex(const std::string& library_filename) {
+    const auto& info       = m_known_extensions.at(library_filename);
+    const auto  library_id = internString(library_filename);
+
+    for (const auto& desc : info.extensions) {
+        m_index.interface_ids.push_back(internString(desc.interface_name()));
+        m_index.name_ids.push_back(internString(desc.name()));
+        m_index.versions.push_back(desc.version());
+        m_index.library_ids.push_back(library_id);
+        m_index.entry_point_ids.push_back(internString(desc.get("entry_point")));
+        m_index.descriptions.push_back(&desc);
+
+        // equal versions keep the order in which they were added
+        auto&              versions = m_index.versions_by_name[nameKey(m_index.interface_ids.back(), m_index.name_ids.back())];
+        const VersionEntry entry{desc.semanticVersion(), desc.version(), &desc};
+        versions.insert(std::upper_bound(versions.begin(), versions.end(), entry, lessVersion<VersionEntry>), entry);
+    }
+}
+
+void ExtensionSystem::removeFromIndex(const std::string& library_filename) {
+    std::uint32_t library_id{};
+    if (!findStringId(library_filename, library_id))
+        return;
+
+    // remove the rows of the library from all columns in a single pass, the order of the other rows is kept
+    std::size_t kept = 0;
+    for (std::size_t row = 0; row < m_index.size(); ++row) {
+        if (m_index.library_ids[row] == library_id)
+            continue;
+        m_index.interface_ids[kept]   = m_index.interface_ids[row];
+        m_index.name_ids[kept]        = m_index.name_ids[row];
+        m_index.versions[kept]        = m_index.versions[row];
+        m_index.library_ids[kept]     = m_index.library_ids[row];
+        m_index.entry_point_ids[kept] = m_index.entry_point_ids[row];
+        m_index.descriptions[kept]    = m_index.descriptions[row];
+        ++kept;
+    }
+
+    m_index.interface_ids.resize(kept);
+    m_index.name_ids.resize(kept);
+    m_index.versions.resize(kept);
+    m_index.library_ids.resize(kept);
+    m_index.entry_point_ids.resize(kept);
+    m_index.descriptions.resize(kept);
+
+    for (const auto& desc : m_known_extensions.at(library_filename).extensions) {
+        const auto iter = m_index.versions_by_name.find(nameKey(m_string_ids.at(desc.interface_name()), m_string_ids.at(desc.name())));
+        if (iter == m_index.versions_by_name.end())
+            continue;
+        auto& versions = iter->second;
+        versions.erase(std::remove_if(versions.begin(), versions.end(), [&](const VersionEntry& e) { return e.description == &desc; }),
+                       versions.end());
+        if (versions.empty())
+            m_index.versions_by_name.erase(iter);
+    }
 }
 
 std::vector<ExtensionDescription> ExtensionSystem::extensions(const std::vector<std::pair<std::string, std::string>>& metaDataFilter) const {
+    // filters on indexed keys compare ids, all other keys are looked up in the metadata of the extension
+    struct ColumnFilter final {
+        const std::vector<std::uint32_t>* column;
+        std::vector<std::uint32_t>        ids;
+    };
+    std::vector<ColumnFilter> column_filters;
+
     const auto filter_map = [&] {
         std::unordered_map<std::string, std::unordered_set<std::string>> m;
         for (const auto& f : metaDataFilter)
@@ -338,33 +1193,61 @@ std::vector<ExtensionDescription> ExtensionSystem::extensions(const std::vector<
         return m;
     }();
 
+    std::unordered_map<std::string, const std::unordered_set<std::string>*> metadata_filters;
+    for (const auto& filter : filter_map) {
+        const auto* column = indexColumn(filter.first);
+        if (column == nullptr) {
+            metadata_filters.emplace(filter.first, &filter.second);
+            continue;
+        }
+
+        ColumnFilter column_filter{column, {}};
+        for (const auto& value : filter.second) {
+            std::uint32_t id{};
+            if (findStringId(value, id))
+                column_filter.ids.push_back(id);
+        }
+        if (column_filter.ids.empty())
+            return {}; // no extension has any of the values
+        column_filters.push_back(std::move(column_filter));
+    }
+
     std::vector<ExtensionDescription> result;
 
-    for (const auto& i : m_known_extensions) {
-        for (const auto& j : i.second.extensions) {
-            // check all filters
-            bool add_extension = true;
+    for (std::size_t row = 0; row < m_index.size(); ++row) {
+        // check all filters
+        bool add_extension = true;
 
-            for (const auto& filter : filter_map) {
-                const auto& extended = j.data();
+        for (const auto& filter : column_filters) {
+            if (std::find(filter.ids.begin(), filter.ids.end(), (*filter.column)[row]) == filter.ids.end()) {
+                add_extension = false;
+                break;
+            }
+        }
 
-                // search extended data if filtered metadata is present
-                auto ext_iter = extended.find(filter.first);
+        const auto& desc = *m_index.descriptions[row];
 
-                if (ext_iter == extended.end()) {
-                    add_extension = false;
-                    break;
-                }
+        for (const auto& filter : metadata_filters) {
+            if (!add_extension)
+                break;
 
-                // check if metadata value is within filter values
-                if (filter.second.find(ext_iter->second) == filter.second.end()) {
-                    add_extension = false;
-                    break;
-                }
+            // search extended data if filtered metadata is present
+            const auto* entry = desc.find(filter.first.data(), filter.first.size());
+
+            if (entry == nullptr) {
+                add_extension = false;
+                break;
+            }
+
+            // check if metadata value is within filter values
+            if (filter.second->find(std::string{entry->value, entry->value_size}) == filter.second->end()) {
+                add_extension = false;
+                break;
             }
-            if (add_extension)
-                result.push_back(j);
         }
+
+        if (add_extension)
+            result.push_back(desc);
     }
 
     return result;
@@ -372,40 +1255,78 @@ std::vector<ExtensionDescription> ExtensionSystem::extensions(const std::vector<
 
 std::vector<ExtensionDescription> ExtensionSystem::extensions() const {
     std::vector<ExtensionDescription> list;
+    list.reserve(m_index.size());
 
-    for (const auto& i : m_known_extensions)
-        for (const auto& j : i.second.extensions)
-            list.push_back(j);
+    for (const auto* desc : m_index.descriptions)
+        list.push_back(*desc);
 
     return list;
 }
 
+const std::vector<ExtensionSystem::VersionEntry>* ExtensionSystem::findVersions(const std::string& interface_name, const std::string& name) const {
+    std::uint32_t interface_id{};
+    std::uint32_t name_id{};
+    if (!findStringId(interface_name, interface_id) || !findStringId(name, name_id))
+        return nullptr;
+
+    const auto iter = m_index.versions_by_name.find(nameKey(interface_id, name_id));
+    return iter == m_index.versions_by_name.end() ? nullptr : &iter->second;
+}
+
 ExtensionDescription ExtensionSystem::findDescription(const std::string& interface_name, const std::string& name, ExtensionVersion version) const {
-    for (const auto& i : m_known_extensions)
-        for (const auto& j : i.second.extensions)
-            if (j.interface_name() == interface_name && j.name() == name && j.version() == version)
-                return j;
+    const auto* versions = findVersions(interface_name, name);
+    if (versions == nullptr)
+        return {};
+
+    // not ordered by version if extensions export semantic versions
+    for (const auto& e : *versions)
+        if (e.version == version)
+            return *e.description;
 
     return {};
 }
 
 ExtensionDescription ExtensionSystem::findDescription(const std::string& interface_name, const std::string& name) const {
-    ExtensionVersion            highest_version{};
-    const ExtensionDescription* desc{};
+    const auto* versions = findVersions(interface_name, name);
+    if (versions == nullptr)
+        return {};
 
-    for (const auto& i : m_known_extensions) {
-        for (const auto& j : i.second.extensions) {
-            if (j.interface_name() == interface_name && j.name() == name && j.version() > highest_version) {
-                highest_version = j.version();
-                desc            = &j;
-            }
-        }
+    // the highest version like before semantic versions existed, the semantic version only decides between equal versions and
+    // the first one added is used if both are equal
+    const VersionEntry* best{};
+    for (const auto& e : *versions)
+        if (best == nullptr || best->version < e.version || (best->version == e.version && best->semantic_version < e.semantic_version))
+            best = &e;
+    return *best->description;
+}
+
+ExtensionDescription ExtensionSystem::findDescription(const std::string& interface_name, const std::string& name, const VersionRange& range) const {
+    if (!range.isValid()) {
+        m_message_handler("findDescription: invalid version range " + range.toString());
+        return {};
+    }
+
+    const auto* versions = findVersions(interface_name, name);
+    if (versions == nullptr)
+        return {};
+
+    // the highest version below the upper bound of every alternative of the range
+    const auto          below = [](const VersionEntry& e, const SemanticVersion& v) { return e.semantic_version < v; };
+    const VersionEntry* best{};
+    for (const auto& interval : range.intervals()) {
+        const auto end = interval.bounded ? std::lower_bound(versions->begin(), versions->end(), interval.upper, below) : versions->end();
+        if (end == versions->begin() || (end - 1)->semantic_version < interval.lower)
+            continue;
+
+        const auto candidate = std::lower_bound(versions->begin(), end, *(end - 1), lessVersion<VersionEntry>);
+        if (best == nullptr || lessVersion(*best, *candidate))
+            best = &*candidate;
     }
 
-    if (desc == nullptr)
+    if (best == nullptr)
         return {};
 
-    return *desc;
+    return *best->description;
 }
 
 void ExtensionSystem::debugMessage(const std::string& msg) {
@@ -417,6 +1338,26 @@ void ExtensionSystem::setVerifyCompiler(bool enable) {
     m_verify_compiler = enable;
 }
 
+void ExtensionSystem::setCheckFileFormat(bool enable) {
+    m_check_file_format = enable;
+}
+
+void ExtensionSystem::setScanChunkSize(std::size_t size) {
+    m_scan_chunk_size = size != 0 ? size : 1;
+}
+
+void ExtensionSystem::setScanThreads(std::size_t threads) {
+    m_scan_threads = threads != 0 ? threads : 1;
+}
+
 void ExtensionSystem::setEnableDebugOutput(bool enable) {
     m_debug_output = enable;
 }
+
+void ExtensionSystem::setLinkNamespace(LinkNamespace link_namespace) {
+    m_link_namespace = link_namespace;
+}
+
+void ExtensionSystem::setEnableHotReload(bool enable) {
+    m_hot_reload = enable;
+}
@@ -2,7 +2,12 @@
 /// SPDX-License-Identifier: BSL-1.0
 #pragma once
 
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <map>
 #include <sstream>
+#include <tuple>
 #include <vector>
 #include <unordered_map>
 #include <memory>
@@ -10,9 +15,19 @@
 
 #include "Extension.hpp"
 #include "DynamicLibrary.hpp"
+#include "LatencyHistogram.hpp"
+#include "SemanticVersion.hpp"
+#include "Trace.hpp"
 
 namespace extension_system {
 
+class Arena;
+class DirectoryFilter;
+class DirectoryWatcher;
+namespace filesystem {
+class path_resolver;
+}
+
 using ExtensionVersion = uint32_t;
 
 /**
@@ -22,6 +37,7 @@ using ExtensionVersion = uint32_t;
  * \li its name and
  * \li its version.
  * Additionally a extension creator can add metadata to further describe the extension.
+ * The metadata is immutable and shared between all copies of a description, the descriptions of a library share a single arena.
  * The handling of extensions with same name and version number in different libraries is currently broken
  */
 class ExtensionDescription final {
@@ -33,16 +49,14 @@ public:
     ExtensionDescription& operator=(const ExtensionDescription&) = default;
     ~ExtensionDescription() noexcept                             = default;
 
-    ExtensionDescription(std::unordered_map<std::string, std::string>&& data, ExtensionVersion version)
-        : m_data{data}
-        , m_version{version} {}
+    ExtensionDescription(std::unordered_map<std::string, std::string>&& data, ExtensionVersion version, std::uint64_t generation = 0);
 
     /**
      * Returns if the extension is valid. An extension is invalid if the describing data structure was not found within the shared module
      * (.so/.dll ...)
      */
     bool isValid() const {
-        return !m_data.empty();
+        return m_entry_count != 0;
     }
 
     /**
@@ -60,6 +74,27 @@ public:
         return m_version;
     }
 
+    /**
+     * Gets the semantic version of the extension (metadata entry "semantic_version").
+     * @return the semantic version or version().0.0 if the extension doesn't export one
+     */
+    SemanticVersion semanticVersion() const {
+        SemanticVersion result{m_version, 0, 0};
+        const auto*     entry = find("semantic_version", 16);
+        if (entry != nullptr)
+            (void)SemanticVersion::parse(entry->value, entry->value_size, result);
+        return result;
+    }
+
+    /**
+     * Returns the generation of the library scan the description originates from.
+     * Every time a library is (re-)added the generation changes, descriptions of older generations can't be used to create
+     * extensions anymore.
+     */
+    std::uint64_t generation() const {
+        return m_generation;
+    }
+
     /**
      * Returns extensions description.
      */
@@ -84,9 +119,7 @@ public:
     /**
      * Returns a map of additional metadata, defined by extension's author
      */
-    const std::unordered_map<std::string, std::string>& data() const {
-        return m_data;
-    }
+    std::unordered_map<std::string, std::string> data() const;
 
     /**
      * Returns meta data identified by key
@@ -94,10 +127,10 @@ public:
      * @return Metadata associated with key or an empty string if key was not found in meta data
      */
     std::string get(const std::string& key) const {
-        auto iter = m_data.find(key);
-        if (iter == m_data.end())
+        const auto* entry = find(key.data(), key.size());
+        if (entry == nullptr)
             return {};
-        return iter->second;
+        return {entry->value, entry->value_size};
     }
 
     /**
@@ -107,13 +140,42 @@ public:
         return get(key);
     }
 
-    bool operator==(const ExtensionDescription& desc) const {
-        return m_data == desc.m_data && m_version == desc.m_version;
-    }
+    bool operator==(const ExtensionDescription& desc) const;
 
 private:
-    std::unordered_map<std::string, std::string> m_data;
-    ExtensionVersion                             m_version{};
+    friend class ExtensionSystem;
+
+    // key and value are null-terminated
+    struct Entry final {
+        const char*   key;
+        std::uint32_t key_size;
+        std::uint32_t value_size;
+        const char*   value;
+    };
+
+    ExtensionDescription(std::shared_ptr<const Arena> arena,
+                         const Entry*                 entries,
+                         std::size_t                  entry_count,
+                         ExtensionVersion             version,
+                         std::uint64_t                generation)
+        : m_arena{std::move(arena)}
+        , m_entries{entries}
+        , m_entry_count{entry_count}
+        , m_version{version}
+        , m_generation{generation} {}
+
+    const Entry* find(const char* key, std::size_t key_size) const {
+        for (std::size_t i = 0; i < m_entry_count; ++i)
+            if (m_entries[i].key_size == key_size && std::memcmp(m_entries[i].key, key, key_size) == 0)
+                return &m_entries[i];
+        return nullptr;
+    }
+
+    std::shared_ptr<const Arena> m_arena; // owns the entries
+    const Entry*                 m_entries{};
+    std::size_t                  m_entry_count{};
+    ExtensionVersion             m_version{};
+    std::uint64_t                m_generation{};
 };
 
 inline std::string to_string(const ExtensionDescription& e) {
@@ -123,6 +185,80 @@ inline std::string to_string(const ExtensionDescription& e) {
     return out.str();
 }
 
+/**
+ * Defines when a library is unloaded after the last extension created from it was freed
+ */
+enum class UnloadPolicy {
+    Immediate,   ///< unload the library as soon as no extension created from it is alive
+    IdleTimeout, ///< unload the library if no extension created from it was alive for a given time
+    Never        ///< keep the library loaded until the process terminates
+};
+
+/**
+ * Usage information of a loaded library
+ */
+struct LibraryUsage final {
+    std::string   filename;
+    std::uint64_t generation;     ///< generation of the library scan the loaded library belongs to
+    std::size_t   live_instances; ///< number of alive extensions created from this library
+    bool          pinned;         ///< the library is kept loaded by the ExtensionSystem even if live_instances is 0
+    bool          registered;     ///< false if the library was removed or replaced by a newer generation
+};
+
+/**
+ * Instance counts of an extension within a library
+ */
+struct ExtensionUsage final {
+    std::string      library_filename;
+    std::string      interface_name;
+    std::string      name;
+    ExtensionVersion version;
+    std::size_t      live_instances; ///< number of alive instances
+    std::size_t      peak_instances; ///< highest number of simultaneously alive instances
+    std::uint64_t    created;        ///< number of instances created so far
+};
+
+/**
+ * Estimated heap memory used by the registry of an ExtensionSystem in bytes.
+ * The estimate assumes a node based hash table for the library index and ignores the overhead of the allocator.
+ */
+struct MemoryUsage final {
+    struct Library final {
+        std::string filename;
+        std::size_t descriptions{};     ///< storage of the ExtensionDescription objects
+        std::size_t description_maps{}; ///< metadata entry tables in the arena of the library
+        std::size_t metadata_strings{}; ///< keys and values in the arena of the library
+        std::size_t unused{};           ///< reserved but unused memory of the arena
+
+        std::size_t total() const {
+            return descriptions + description_maps + metadata_strings + unused;
+        }
+    };
+
+    std::vector<Library> libraries;
+    std::size_t          descriptions{};     ///< sum over all libraries
+    std::size_t          description_maps{}; ///< sum over all libraries
+    std::size_t          metadata_strings{}; ///< sum over all libraries
+    std::size_t          unused{};           ///< sum over all libraries
+    std::size_t          indexes{};          ///< hash table of the known libraries, extension index and interned strings
+
+    std::size_t total() const {
+        return descriptions + description_maps + metadata_strings + unused + indexes;
+    }
+};
+
+/**
+ * Latencies of a library or of an extension within a library
+ */
+struct LatencyStatistics final {
+    std::string      library_filename;
+    std::string      interface_name; ///< empty for the statistics of the whole library
+    std::string      name;
+    ExtensionVersion version;
+
+    std::shared_ptr<const LatencyHistograms> histograms; ///< still updated by the ExtensionSystem and alive extensions
+};
+
 /**
  * @brief The ExtensionSystem class
  * thread-safe
@@ -139,14 +275,25 @@ public:
 
     /**
      * Scans a dynamic library file for extensions and adds these extensions to the list of known extensions.
+     * Already known libraries are skipped, unless hot reload is enabled and the file changed since it was scanned.
      * @param filename File name of the library
      * @return number of extensions found in the file
      */
     std::size_t addDynamicLibrary(const std::string& filename);
 
+    /**
+     * Returns the extensions of a dynamic library without adding them to the list of known extensions or loading the library.
+     * Libraries that were added and didn't change since are not read again. Only the read-only data sections of ELF files are
+     * searched, other files and files without descriptions in these sections are searched completely.
+     * The descriptions of libraries that weren't added have generation 0, extensions can only be created after adding the library.
+     * @param filename File name of the library
+     */
+    std::vector<ExtensionDescription> probeLibrary(const std::string& filename);
+
     /**
      * Removes all extensions provided by the library from the list of known extensions
-     * Currently instantiated extensions are not affected by this call
+     * Currently instantiated extensions are not affected by this call.
+     * Unless the unload policy is UnloadPolicy::Never the library is unloaded as soon as no extension created from it is alive.
      * @param filename File name of library to remove
      */
     void removeDynamicLibrary(const std::string& filename);
@@ -166,6 +313,15 @@ public:
      */
     void searchDirectory(const std::string& path, const std::string& required_prefix, bool recursive);
 
+    /**
+     * Scans a directory for dynamic libraries and calls addDynamicLibrary for every file accepted by filter
+     * The filter is evaluated on the names of the directory entries, rejected files and directories are never opened.
+     * Include <extension_system/DirectoryFilter.hpp> to create filters.
+     * @param path Path to search in for extensions
+     * @param filter Glob and regex rules for file and directory names and the number of subdirectory levels to search
+     */
+    void searchDirectory(const std::string& path, const DirectoryFilter& filter);
+
     /**
      * Returns a list of all known extensions
      */
@@ -200,7 +356,26 @@ public:
      */
     template <class T>
     std::shared_ptr<T> createExtension(const std::string& name, ExtensionVersion version) {
+        EXTENSION_SYSTEM_TRACE_SCOPE(lookup_span, "lookup", name);
         auto desc = findDescription(extension_system::InterfaceName<T>::getString(), name, version);
+        EXTENSION_SYSTEM_TRACE_END(lookup_span);
+        if (!desc.isValid())
+            return {};
+        return createExtension<T>(desc);
+    }
+
+    /**
+     * Creates an instance of the highest semantic version of an extension within a range of versions
+     * Instantiated extension can outlive the ExtensionSystem (instance)
+     * @param name Name of extension to create
+     * @param range Versions that can be used, e.g. ">=1.2 <2" or "^1.4", see VersionRange
+     * @return An instance of an extension class or nullptr, if extension could not be instantiated
+     */
+    template <class T>
+    std::shared_ptr<T> createExtension(const std::string& name, const VersionRange& range) {
+        EXTENSION_SYSTEM_TRACE_SCOPE(lookup_span, "lookup", name);
+        auto desc = findDescription(extension_system::InterfaceName<T>::getString(), name, range);
+        EXTENSION_SYSTEM_TRACE_END(lookup_span);
         if (!desc.isValid())
             return {};
         return createExtension<T>(desc);
@@ -208,13 +383,16 @@ public:
 
     /**
      * Creates an instance of an extension. If the extension is available in multiple versions, the highest version will be instantiated
+     * The version decides and not the semantic version, use createExtension(name, "*") for the highest semantic version
      * Instantiated extension can outlive the ExtensionSystem (instance)
      * @param name Name of extension to create
      * @return An instance of an extension class or nullptr, if extension could not be instantiated
      */
     template <class T>
     std::shared_ptr<T> createExtension(const std::string& name) {
+        EXTENSION_SYSTEM_TRACE_SCOPE(lookup_span, "lookup", name);
         const auto desc = findDescription(extension_system::InterfaceName<T>::getString(), name);
+        EXTENSION_SYSTEM_TRACE_END(lookup_span);
         if (!desc.isValid())
             return {};
         return createExtension<T>(desc);
@@ -231,30 +409,101 @@ public:
         if (!desc.isValid() || extension_system::InterfaceName<T>::getString() != desc.interface_name())
             return {};
 
-        for (auto& i : m_known_extensions) {
-            for (auto& j : i.second.extensions) {
-                if (j == desc) {
-                    auto dynlib = std::make_shared<DynamicLibrary>(i.first);
-                    if (!dynlib->isValid())
-                        m_message_handler("_createExtension: " + dynlib->getError());
-
-                    if (dynlib == nullptr)
-                        continue;
-
-                    const auto func = dynlib->getProcAddress<T*(T*, const char**)>(j.get("entry_point"));
-
-                    if (func != nullptr) {
-                        T* ex = func(nullptr, nullptr);
-                        if (ex != nullptr) {
-                            return std::shared_ptr<T>(ex, [dynlib, func](T* obj) { func(obj, nullptr); });
-                        }
-                    }
-                }
-            }
-        }
-        return {};
+        EXTENSION_SYSTEM_TRACE_SCOPE(create_span, "createExtension", desc.library_filename());
+        auto library = loadLibrary(desc);
+        if (library == nullptr)
+            return {};
+
+        EXTENSION_SYSTEM_TRACE_SCOPE(dlsym_span, "dlsym", library->filename);
+        const auto func = library->library.getProcAddress<T*(T*, const char**)>(desc.get("entry_point"));
+        EXTENSION_SYSTEM_TRACE_END(dlsym_span);
+        if (func == nullptr)
+            return {};
+
+        EXTENSION_SYSTEM_TRACE_SCOPE(construct_span, "construct", library->filename);
+        const auto construct_start = std::chrono::steady_clock::now();
+        T*         ex              = func(nullptr, nullptr);
+        const auto construct_time  = std::chrono::steady_clock::now() - construct_start;
+        EXTENSION_SYSTEM_TRACE_END(construct_span);
+        if (ex == nullptr)
+            return {};
+
+        auto record = extensionRecord(desc);
+        record->latencies.construct.record(construct_time);
+        library->latencies->construct.record(construct_time);
+
+        record->acquire();
+        library->acquire();
+        return std::shared_ptr<T>(ex, [library, record, func](T* obj) mutable {
+            EXTENSION_SYSTEM_TRACE_SCOPE(destroy_span, "destroyExtension", library->filename);
+            const auto destroy_start = std::chrono::steady_clock::now();
+            func(obj, nullptr);
+            const auto destroy_time = std::chrono::steady_clock::now() - destroy_start;
+            record->latencies.destroy.record(destroy_time);
+            library->latencies->destroy.record(destroy_time);
+            record->release();
+            record.reset();
+            library->release();
+            library.reset(); // don't wait until the control block is freed (weak_ptrs)
+        });
+    }
+
+    /**
+     * Sets the unload policy for libraries
+     * Libraries loaded with UnloadPolicy::Never stay in memory even if the policy is changed afterwards.
+     * @param policy the new policy
+     * @param idle_timeout time a library is kept loaded after the last extension was freed (only used with UnloadPolicy::IdleTimeout)
+     */
+    void setUnloadPolicy(UnloadPolicy policy, std::chrono::milliseconds idle_timeout = std::chrono::milliseconds{0});
+
+    UnloadPolicy getUnloadPolicy() const {
+        return m_unload_policy;
     }
 
+    /**
+     * Releases all libraries that are only kept loaded by the unload policy and exceeded the idle timeout.
+     * Is called implicitly by createExtension when the UnloadPolicy::IdleTimeout is used.
+     * @return number of released libraries
+     */
+    std::size_t unloadIdleLibraries();
+
+    /**
+     * Returns all libraries that are currently loaded, either by alive extensions or by the unload policy
+     */
+    std::vector<LibraryUsage> loadedLibraries() const;
+
+    /**
+     * Returns the estimated memory used by the known libraries and their extension descriptions
+     */
+    MemoryUsage memoryUsage() const;
+
+    /**
+     * Returns the instance counts of all extensions that were created at least once.
+     * Extensions that are never freed show up with a growing live_instances count.
+     */
+    std::vector<ExtensionUsage> extensionUsage() const;
+
+    /**
+     * Sets the peak_instances of all extensions to their current number of alive instances
+     */
+    void resetPeakInstances();
+
+    /**
+     * Returns the latency histograms of all libraries and all extensions that were scanned or created.
+     * The statistics are kept if a library is removed or reloaded.
+     */
+    std::vector<LatencyStatistics> latencies() const;
+
+    /**
+     * Returns the latency histograms in the Prometheus text exposition format
+     */
+    std::string latencyMetrics() const;
+
+    /**
+     * Clears the latency histograms of all libraries and extensions
+     */
+    void resetLatencies();
+
     /**
      * Sets a message handler.
      * A message handler is a function that should be called if the ExtensionSystem detects an non fatal error while adding a library.
@@ -282,16 +531,186 @@ public:
      */
     void setVerifyCompiler(bool enable);
 
+    /**
+     * If enabled (default), searchDirectory and watched directories skip files that aren't shared libraries for the current
+     * platform and architecture (see DynamicLibrary::checkFileFormat) before reading them.
+     * addDynamicLibrary always reads the given file.
+     */
+    void setCheckFileFormat(bool enable);
+
+    /**
+     * Sets the size of the chunks libraries are read in if the ExtensionSystem was built without Boost (default 1 MiB).
+     * Descriptions spanning chunks are carried until their end tag, the memory used for scanning doesn't depend on the size of the
+     * libraries. Libraries are memory mapped if Boost is available, the chunk size is ignored then.
+     */
+    void setScanChunkSize(std::size_t size);
+
+    /**
+     * Sets the number of threads searchDirectory, processDirectoryChanges and reloadChangedLibraries use to open and read
+     * libraries (default 16). Keeping many reads in flight hides the latency of cold caches and network storage.
+     * The extensions are still added by the calling thread in the order the files were found, 1 disables the worker threads.
+     */
+    void setScanThreads(std::size_t threads);
+
     void setEnableDebugOutput(bool enable);
 
-private:
-    std::size_t addDynamicLibrary(const std::string& filename, std::vector<char>& buffer);
-    std::size_t addExtensions(const std::string& filename, const char* file_content, std::size_t file_length);
-    std::unordered_map<std::string, std::string> parseKeyValue(const std::string& filename, const char* start, const char* end);
-    ExtensionDescription                         parse(const std::string& filename, std::unordered_map<std::string, std::string>&& desc);
+    LinkNamespace getLinkNamespace() const {
+        return m_link_namespace;
+    }
+
+    /**
+     * Sets the link-map namespace libraries are loaded into, only affects libraries that are loaded afterwards.
+     * Isolated libraries can bundle different versions of the same dependency, but each namespace has its own copy of the C and C++
+     * runtime. Objects must not be allocated in one namespace and freed in another one (e.g. std::string return values).
+     * See DynamicLibrary::setMaxLinkNamespaces for the handling of namespace exhaustion.
+     */
+    void setLinkNamespace(LinkNamespace link_namespace);
+
+    bool getEnableHotReload() const {
+        return m_hot_reload;
+    }
+
+    /**
+     * Enables or disables the hot reload mode.
+     * If enabled, addDynamicLibrary and searchDirectory replace the extensions of known libraries whose files changed
+     * (modification time, size or inode). The new descriptions get a new generation.
+     * Alive extensions keep the previously loaded library loaded until they are freed.
+     * New extensions are loaded from a temporary copy of the changed file, since the dynamic loader would return the already
+     * loaded library otherwise.
+     */
+    void setEnableHotReload(bool enable);
+
+    bool getEnableDirectoryWatch() const {
+        return m_watcher != nullptr;
+    }
+
+    /**
+     * Enables or disables watching the directories passed to searchDirectory.
+     * Only directories searched after enabling are watched, disabling stops watching all directories.
+     * Changes are applied by calling processDirectoryChanges.
+     * Uses inotify on linux, on other platforms the directories are polled.
+     */
+    void setEnableDirectoryWatch(bool enable);
 
+    /**
+     * Applies the changes within the watched directories since the last call, without walking the directories again.
+     * Created and moved in files are added, modified files are reloaded and deleted or moved out files are removed.
+     * Like reloadChangedLibraries, modified files are reloaded independent of setEnableHotReload.
+     * Every file is only processed once, bursts of changes (e.g. package installs) are coalesced as long as new changes arrive within
+     * settle_time.
+     * @return number of processed files
+     */
+    std::size_t processDirectoryChanges(std::chrono::milliseconds settle_time = std::chrono::milliseconds{0});
+
+    /**
+     * Checks all known libraries for changes and re-scans changed libraries, libraries whose files are gone are removed.
+     * Works independent of setEnableHotReload, changed libraries that were already loaded are loaded from a temporary copy.
+     * @return number of reloaded or removed libraries
+     */
+    std::size_t reloadChangedLibraries();
+
+private:
+    // a library that is opened and read on a worker thread and added by the thread that called the ExtensionSystem
+    struct ScanJob;
+    std::size_t addDynamicLibrary(const std::string& filename, bool reload_changed, bool check_format, filesystem::path_resolver& resolver);
+    std::size_t addDynamicLibraries(const std::vector<std::string>& filenames, bool reload_changed, bool check_format);
+    void        openLibrary(ScanJob& job, filesystem::path_resolver& resolver) const;
+    bool        needsScan(const ScanJob& job, bool reload_changed);
+    void        readLibrary(ScanJob& job, bool check_format, std::vector<char>& buffer) const;
+    std::size_t applyScan(const ScanJob& job);
+    std::size_t addExtensions(const std::string& filename, const std::string& file_path, const char* file_content, std::size_t file_length);
+    std::vector<ExtensionDescription> parseSections(const std::string&            filename,
+                                                    const std::string&            file_path,
+                                                    const char*                   file_content,
+                                                    std::size_t                   file_length,
+                                                    const std::shared_ptr<Arena>& arena,
+                                                    std::uint64_t                 generation);
+    bool parseKeyValue(const std::string& filename, const char* start, const char* end, std::vector<ExtensionDescription::Entry>& result);
+    bool isBinaryMetadata(const char* start, const char* end) const;
+    bool parseBinaryEntries(const std::string&                        filename,
+                            const char*                               start,
+                            const char*                               end,
+                            std::vector<ExtensionDescription::Entry>& result,
+                            ExtensionVersion&                         version,
+                            bool&                                     verified);
+    ExtensionDescription parse(const std::string&                              filename,
+                               const std::vector<ExtensionDescription::Entry>& entries,
+                               const std::shared_ptr<Arena>&                   arena,
+                               const ExtensionDescription::Entry&              library_filename,
+                               std::uint64_t                                   generation,
+                               const ExtensionVersion*                         encoded_version);
+
+    // invalid descriptions are returned if no matching extension is known, only range lookups order by the semantic version
     ExtensionDescription findDescription(const std::string& interface_name, const std::string& name, ExtensionVersion version) const;
     ExtensionDescription findDescription(const std::string& interface_name, const std::string& name) const;
+    ExtensionDescription findDescription(const std::string& interface_name, const std::string& name, const VersionRange& range) const;
+
+    // shared between the ExtensionSystem and the deleters of all extensions created from the library
+    struct LoadedLibrary final {
+        LoadedLibrary(std::string                        filename,
+                      std::string                        copy_path,
+                      bool                               allow_unload,
+                      LinkNamespace                      ns,
+                      std::uint64_t                      generation,
+                      std::shared_ptr<LatencyHistograms> latencies)
+            : filename{std::move(filename)}
+            , copy_path{std::move(copy_path)}
+            , library{this->copy_path.empty() ? this->filename : this->copy_path, allow_unload, ns}
+            , generation{generation}
+            , latencies{std::move(latencies)} {}
+
+        LoadedLibrary(const LoadedLibrary&) = delete;
+        LoadedLibrary& operator=(const LoadedLibrary&) = delete;
+        ~LoadedLibrary();
+
+        void acquire() {
+            ++live_instances;
+        }
+
+        void release() {
+            last_release = std::chrono::steady_clock::now().time_since_epoch().count();
+            --live_instances;
+        }
+
+        const std::string                           filename;
+        const std::string                           copy_path; // private copy that was loaded instead of filename, empty if none
+        DynamicLibrary                              library;
+        const std::uint64_t                         generation;
+        const std::shared_ptr<LatencyHistograms>    latencies; // of the library, shared with m_library_latencies
+        std::atomic<std::size_t>                    live_instances{0};
+        std::atomic<std::chrono::steady_clock::rep> last_release{0};
+    };
+
+    std::shared_ptr<LoadedLibrary> loadLibrary(const ExtensionDescription& desc);
+
+    // shared between the ExtensionSystem and the deleters of all instances of an extension
+    struct ExtensionRecord final {
+        void acquire() {
+            ++created;
+            const std::size_t live = ++live_instances;
+            auto              peak = peak_instances.load();
+            while (live > peak && !peak_instances.compare_exchange_weak(peak, live)) { }
+        }
+
+        void release() {
+            --live_instances;
+        }
+
+        LatencyHistograms          latencies;
+        std::atomic<std::size_t>   live_instances{0};
+        std::atomic<std::size_t>   peak_instances{0};
+        std::atomic<std::uint64_t> created{0};
+    };
+
+    std::shared_ptr<LatencyHistograms> libraryLatencies(const std::string& filename);
+    std::shared_ptr<ExtensionRecord>   extensionRecord(const ExtensionDescription& desc);
+
+    struct FileStamp final {
+        std::uint64_t device{};
+        std::uint64_t inode{};
+        std::uint64_t size{};
+        std::int64_t  modification_time{};
+    };
 
     struct LibraryInfo final {
         LibraryInfo()                   = default;
@@ -303,16 +722,96 @@ private:
         explicit LibraryInfo(std::vector<ExtensionDescription> ex)
             : extensions{std::move(ex)} {}
 
+        std::shared_ptr<Arena>            arena; // metadata of the extensions, shared with all copies of the descriptions
         std::vector<ExtensionDescription> extensions;
+        std::uint64_t                     generation{};
+        FileStamp                         stamp;
+        std::weak_ptr<LoadedLibrary>      library;
+        std::shared_ptr<LoadedLibrary>    pinned; // keeps the library loaded according to the unload policy
+    };
+
+    struct ScanJob final {
+        std::string                         filename;
+        std::string                         file_path; // empty if the file doesn't exist
+        bool                                is_directory{};
+        FileStamp                           stamp;
+        bool                                ignored{}; // rejected by DynamicLibrary::checkFileFormat
+        std::string                         error;     // why the file was ignored or couldn't be read
+        std::vector<char>                   sections;  // metadata sections of the file
+        std::chrono::steady_clock::duration scan_time{};
+    };
+
+    // structure of arrays with one row per known extension, strings are replaced by ids of m_string_ids
+    // lookups are linear passes over a few contiguous integer columns instead of chasing pointers through the libraries
+    struct VersionEntry final {
+        SemanticVersion             semantic_version;
+        ExtensionVersion            version;
+        const ExtensionDescription* description;
+    };
+
+    struct ExtensionIndex final {
+        std::vector<std::uint32_t>               interface_ids;
+        std::vector<std::uint32_t>               name_ids;
+        std::vector<ExtensionVersion>            versions;
+        std::vector<std::uint32_t>               library_ids;
+        std::vector<std::uint32_t>               entry_point_ids;
+        std::vector<const ExtensionDescription*> descriptions; // metadata of the row, owned by m_known_extensions
+
+        // the versions of every interface and name (key is interface id << 32 | name id) ordered by their semantic version and
+        // version, the best version is found by a binary search
+        std::unordered_map<std::uint64_t, std::vector<VersionEntry>> versions_by_name;
+
+        std::size_t size() const {
+            return descriptions.size();
+        }
     };
 
+    std::uint32_t                     internString(const std::string& str);
+    bool                              findStringId(const std::string& str, std::uint32_t& id) const;
+    const std::vector<std::uint32_t>* indexColumn(const std::string& key) const;
+    const std::vector<VersionEntry>*  findVersions(const std::string& interface_name, const std::string& name) const;
+    void                              addToIndex(const std::string& library_filename);
+    void                              removeFromIndex(const std::string& library_filename);
+
+    void eraseLibrary(std::unordered_map<std::string, LibraryInfo>::iterator iter);
+    void detachLibrary(const LibraryInfo& info);
+    void watchDirectory(const std::string& path, const std::string& required_prefix, bool recursive);
+    void watchDirectory(const std::string& path, const DirectoryFilter& filter);
+
     void debugMessage(const std::string& msg);
 
-    bool m_verify_compiler = true;
-    bool m_debug_output    = false;
+    bool m_verify_compiler   = true;
+    bool m_check_file_format = true;
+    bool m_debug_output      = false;
+    bool m_hot_reload        = false;
+
+    std::uint64_t m_generation = 0;
+
+    std::size_t m_scan_chunk_size = 1024 * 1024;
+    std::size_t m_scan_threads    = 16;
+
+    // files that were loaded from their own path and their stamp at that time, the dynamic loader returns the already loaded
+    // library when they are loaded again
+    std::unordered_map<std::string, FileStamp> m_loaded_files;
+
+    LinkNamespace             m_link_namespace = LinkNamespace::Global;
+    UnloadPolicy              m_unload_policy  = UnloadPolicy::Never;
+    std::chrono::milliseconds m_idle_timeout{0};
+
+    // libraries that were removed using removeDynamicLibrary while extensions created from them were still alive
+    std::vector<std::weak_ptr<LoadedLibrary>> m_detached_libraries;
+
+    std::unique_ptr<DirectoryWatcher> m_watcher;
+
+    // library filename, interface name, name, version
+    using ExtensionKey = std::tuple<std::string, std::string, std::string, ExtensionVersion>;
+    std::map<std::string, std::shared_ptr<LatencyHistograms>>  m_library_latencies;
+    std::map<ExtensionKey, std::shared_ptr<ExtensionRecord>>   m_extension_records;
 
-    std::function<void(const std::string&)>      m_message_handler;
-    std::unordered_map<std::string, LibraryInfo> m_known_extensions;
+    std::function<void(const std::string&)>        m_message_handler;
+    std::unordered_map<std::string, LibraryInfo>   m_known_extensions;
+    std::unordered_map<std::string, std::uint32_t> m_string_ids; // interned interface names, names, entry points and libraries
+    ExtensionIndex                                 m_index;
 
     // The following strings are used to find the exported classes in the dll/so files
     // The strings are concatenated at runtime to avoid that they are found in the ExtensionSystem binary.
@@ -0,0 +1,149 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+namespace extension_system {
+
+/**
+ * Histogram of durations with logarithmic buckets that are linearly subdivided (HDR histogram layout).
+ * Every power of two is split into 8 buckets, the relative error of a recorded value is below 12.5%.
+ * Durations below 8ns are exact, durations above ~68s are recorded into the last bucket.
+ * Recording is lock-free and can be done from multiple threads.
+ */
+class LatencyHistogram final {
+public:
+    using Duration = std::chrono::nanoseconds;
+
+    LatencyHistogram() = default;
+    LatencyHistogram(LatencyHistogram&&)      = delete;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(LatencyHistogram&&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    ~LatencyHistogram() noexcept                         = default;
+
+    template <typename Rep, typename Period>
+    void record(std::chrono::duration<Rep, Period> duration) {
+        const auto ns    = std::chrono::duration_cast<Duration>(duration).count();
+        const auto value = ns > 0 ? static_cast<std::uint64_t>(ns) : std::uint64_t{0};
+
+        m_buckets[bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
+        m_count.fetch_add(1, std::memory_order_relaxed);
+        m_sum.fetch_add(value, std::memory_order_relaxed);
+
+        auto max = m_max.load(std::memory_order_relaxed);
+        while (value > max && !m_max.compare_exchange_weak(max, value, std::memory_order_relaxed)) { }
+    }
+
+    std::uint64_t count() const {
+        return m_count.load(std::memory_order_relaxed);
+    }
+
+    Duration sum() const {
+        return Duration{static_cast<Duration::rep>(m_sum.load(std::memory_order_relaxed))};
+    }
+
+    Duration max() const {
+        return Duration{static_cast<Duration::rep>(m_max.load(std::memory_order_relaxed))};
+    }
+
+    /**
+     * Returns the upper bound of the bucket that contains the given percentile
+     * @param percentile 0-100
+     */
+    Duration percentile(double percentile) const {
+        const auto total = count();
+        if (total == 0)
+            return Duration{0};
+
+        auto target = static_cast<std::uint64_t>(static_cast<double>(total) * percentile / 100.0 + 0.5);
+        if (target == 0)
+            target = 1;
+
+        std::uint64_t sum = 0;
+        for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+            sum += m_buckets[i].load(std::memory_order_relaxed);
+            if (sum >= target)
+                return std::min(Duration{static_cast<Duration::rep>(bucketUpperBound(i))}, max());
+        }
+        return max();
+    }
+
+    /**
+     * Calls func for every non-empty bucket in ascending order
+     * @param func gets the inclusive upper bound of the bucket and the number of values in it
+     */
+    void forEachBucket(const std::function<void(Duration upper_bound, std::uint64_t count)>& func) const {
+        for (std::size_t i = 0; i < m_buckets.size(); ++i) {
+            const auto c = m_buckets[i].load(std::memory_order_relaxed);
+            if (c != 0)
+                func(Duration{static_cast<Duration::rep>(bucketUpperBound(i))}, c);
+        }
+    }
+
+    /// not atomic with respect to concurrent calls of record
+    void reset() {
+        for (auto& b : m_buckets)
+            b.store(0, std::memory_order_relaxed);
+        m_count.store(0, std::memory_order_relaxed);
+        m_sum.store(0, std::memory_order_relaxed);
+        m_max.store(0, std::memory_order_relaxed);
+    }
+
+private:
+    enum : std::uint64_t {
+        sub_bucket_bits  = 3,
+        sub_bucket_count = 1U << sub_bucket_bits,
+        max_value_bits   = 36,
+        bucket_count     = (max_value_bits - sub_bucket_bits + 1) * sub_bucket_count
+    };
+
+    static unsigned highestBit(std::uint64_t value) {
+#if defined(__GNUC__)
+        return 63U - static_cast<unsigned>(__builtin_clzll(value));
+#else
+        unsigned result = 0;
+        while ((value >>= 1U) != 0)
+            ++result;
+        return result;
+#endif
+    }
+
+    static std::size_t bucketIndex(std::uint64_t value) {
+        if (value < sub_bucket_count)
+            return static_cast<std::size_t>(value);
+        const auto shift = highestBit(value) - sub_bucket_bits;
+        const auto index = (shift + 1) * sub_bucket_count + ((value >> shift) - sub_bucket_count);
+        return static_cast<std::size_t>(index < bucket_count ? index : bucket_count - 1);
+    }
+
+    static std::uint64_t bucketUpperBound(std::size_t index) {
+        if (index < sub_bucket_count)
+            return index;
+        const auto shift = index / sub_bucket_count - 1;
+        const auto sub   = index % sub_bucket_count + sub_bucket_count;
+        return ((sub + 1) << shift) - 1;
+    }
+
+    std::array<std::atomic<std::uint64_t>, bucket_count> m_buckets{};
+    std::atomic<std::uint64_t>                           m_count{0};
+    std::atomic<std::uint64_t>                           m_sum{0};
+    std::atomic<std::uint64_t>                           m_max{0};
+};
+
+/**
+ * Latencies of the operations done by an ExtensionSystem
+ */
+struct LatencyHistograms final {
+    LatencyHistogram scan;      ///< reading and parsing a library, only recorded per library
+    LatencyHistogram dlopen;    ///< loading a library, recorded for the library and the extension that triggered the loading
+    LatencyHistogram construct; ///< calling the entry point to create an extension
+    LatencyHistogram destroy;   ///< calling the entry point to free an extension
+};
+}
@@ -0,0 +1,297 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#include "MetadataReader.hpp"
+
+#include "StringSearch.hpp"
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+#ifdef EXTENSION_SYSTEM_USE_BOOST
+#ifdef _WIN32
+#define BOOST_DATE_TIME_NO_LIB
+#endif
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#endif
+
+using namespace extension_system;
+
+namespace {
+// a description that doesn't end within this limit is treated as if the end tag was missing
+const std::size_t max_description_size = 1024 * 1024;
+
+class SectionExtractor final {
+public:
+    SectionExtractor(const std::string& start_tag, const std::string& end_tag, std::vector<char>& sections)
+        : m_start_tag{start_tag}
+        , m_scanner{start_tag, end_tag}
+        , m_sections{sections} { }
+
+    /**
+     * Copies the complete sections in [first, last), the tags are found in a single pass
+     * @return the position from which the search has to continue once the data following last is available
+     */
+    const char* extract(const char* first, const char* last, bool end_of_file) {
+        const char* start    = nullptr; // start tag of the current section
+        const char* consumed = first;
+        auto        m        = m_scanner.next(first, last);
+        while (true) {
+            if (start != nullptr && static_cast<std::size_t>(m.position - start) > max_description_size) {
+                // only the oversized section is dropped, the search continues after its start tag
+                addMissingEnd();
+                m     = m_scanner.next(start + 1, last);
+                start = nullptr;
+                continue;
+            }
+            if (m.position == last)
+                break;
+
+            if (m.kind == MarkerScanner::Kind::Start) {
+                // interleaved start tags are copied as well, the parser reports them
+                if (start == nullptr)
+                    start = m.position;
+            } else if (start != nullptr) {
+                consumed = m.position + m_scanner.length(m.kind);
+                m_sections.insert(m_sections.end(), start, consumed);
+                start = nullptr;
+            }
+            m = m_scanner.next(m.position + 1, last);
+        }
+
+        if (start != nullptr) {
+            if (!end_of_file)
+                return start; // the section continues in the next chunk
+            addMissingEnd();
+            return last;
+        }
+
+        // keep the bytes that could be the beginning of a tag split by the chunk boundary
+        const auto overlap = m_start_tag.length() - 1;
+        if (end_of_file)
+            return last;
+        return static_cast<std::size_t>(last - consumed) > overlap ? last - overlap : consumed;
+    }
+
+    void addMissingEnd() {
+        m_missing_end = true;
+    }
+
+    /// a single start tag after all sections, the parser reports it as missing end tag without skipping the sections before it
+    void finish() {
+        if (m_missing_end)
+            m_sections.insert(m_sections.end(), m_start_tag.begin(), m_start_tag.end());
+    }
+
+private:
+    const std::string& m_start_tag;
+    MarkerScanner      m_scanner;
+    std::vector<char>& m_sections;
+    bool               m_missing_end{};
+};
+} // namespace
+
+namespace {
+bool readRanges(const std::string&            filename,
+                const std::vector<FileRange>* ranges,
+                const std::string&            start_tag,
+                const std::string&            end_tag,
+                std::size_t                   chunk_size,
+                std::vector<char>&            buffer,
+                std::vector<char>&            sections,
+                std::string&                  error) {
+    SectionExtractor extractor{start_tag, end_tag, sections};
+
+#ifdef EXTENSION_SYSTEM_USE_BOOST
+    (void)chunk_size;
+    (void)buffer;
+    const boost::interprocess::mode_t mode{boost::interprocess::read_only};
+    boost::interprocess::file_mapping fm;
+    try {
+        fm = boost::interprocess::file_mapping(filename.c_str(), mode);
+    } catch (const boost::interprocess::interprocess_exception& e) {
+        error = std::string("file_mapping failed ") + e.what();
+        return false;
+    }
+
+    boost::interprocess::mapped_region file;
+    try {
+        file = boost::interprocess::mapped_region(fm, mode, 0, 0);
+    } catch (const boost::interprocess::interprocess_exception& e) {
+        error = std::string("mapped_region failed ") + e.what();
+        return false;
+    }
+
+    const auto* file_content = reinterpret_cast<const char*>(file.get_address()); // NOLINT
+    const auto  file_length  = static_cast<std::uint64_t>(file.get_size());
+    const std::vector<FileRange> whole_file{FileRange{0, file_length}};
+    for (const auto& range : ranges != nullptr ? *ranges : whole_file) {
+        if (range.offset > file_length || range.size > file_length - range.offset) {
+            error = "range exceeds the file";
+            return false;
+        }
+        const char* first = file_content + range.offset;
+        (void)extractor.extract(first, first + range.size, true);
+    }
+#else
+    std::ifstream file;
+    file.open(filename, std::ios::in | std::ios::binary | std::ios::ate);
+
+    if (!file) {
+        error = "couldn't open file";
+        return false;
+    }
+
+    const auto file_length = file.tellg();
+    if (file_length <= 0) {
+        error = "invalid or unknown file size";
+        return false;
+    }
+
+    const std::vector<FileRange> whole_file{FileRange{0, static_cast<std::uint64_t>(file_length)}};
+    for (const auto& range : ranges != nullptr ? *ranges : whole_file) {
+        file.clear();
+        file.seekg(static_cast<std::streamoff>(range.offset), std::ios::beg);
+
+        // buffer contains the carried over data of the previous chunk followed by the current chunk
+        auto        remaining = range.size;
+        std::size_t carried   = 0;
+        bool        last_chunk{};
+        while (!last_chunk) {
+            // small ranges are read at once
+            const auto size = static_cast<std::size_t>(std::min<std::uint64_t>(chunk_size, remaining));
+            if (buffer.size() < carried + size)
+                buffer.resize(carried + size);
+
+            file.read(buffer.data() + carried, static_cast<std::streamsize>(size));
+            const auto read = static_cast<std::size_t>(file.gcount());
+            remaining -= read;
+            last_chunk = read < size || remaining == 0;
+
+            const char* first = buffer.data();
+            const char* last  = first + carried + read;
+            const char* next  = extractor.extract(first, last, last_chunk);
+
+            // the extractor drops sections exceeding max_description_size, the carried over data is limited by it
+            carried = static_cast<std::size_t>(last - next);
+            std::copy(next, last, buffer.data());
+        }
+    }
+#endif
+
+    extractor.finish();
+    return true;
+}
+
+template <typename T>
+T readHostOrder(const unsigned char* data) {
+    T value{};
+    std::memcpy(&value, data, sizeof(T));
+    return value;
+}
+} // namespace
+
+bool extension_system::readMetadataSections(const std::string& filename,
+                                            const std::string& start_tag,
+                                            const std::string& end_tag,
+                                            std::size_t        chunk_size,
+                                            std::vector<char>& buffer,
+                                            std::vector<char>& sections,
+                                            std::string&       error) {
+    return readRanges(filename, nullptr, start_tag, end_tag, chunk_size, buffer, sections, error);
+}
+
+bool extension_system::readMetadataSections(const std::string&            filename,
+                                            const std::vector<FileRange>& ranges,
+                                            const std::string&            start_tag,
+                                            const std::string&            end_tag,
+                                            std::size_t                   chunk_size,
+                                            std::vector<char>&            buffer,
+                                            std::vector<char>&            sections,
+                                            std::string&                  error) {
+    return readRanges(filename, &ranges, start_tag, end_tag, chunk_size, buffer, sections, error);
+}
+
+bool extension_system::findReadOnlyDataSections(const std::string& filename, std::vector<FileRange>& ranges) {
+    std::ifstream file{filename, std::ios::in | std::ios::binary | std::ios::ate};
+    if (!file)
+        return false;
+    const auto length = file.tellg();
+    if (length <= 0)
+        return false;
+    const auto file_length = static_cast<std::uint64_t>(length);
+
+    unsigned char header[64]{};
+    file.seekg(0, std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(header), sizeof(header))) // NOLINT
+        return false;
+
+    const std::uint16_t one = 1;
+    const unsigned char host_order = *reinterpret_cast<const unsigned char*>(&one) == 1 ? 1 : 2; // NOLINT
+    if (header[0] != 0x7f || header[1] != 'E' || header[2] != 'L' || header[3] != 'F' || header[5] != host_order)
+        return false;
+    if (header[4] != 1 && header[4] != 2) // ELFCLASS32, ELFCLASS64
+        return false;
+
+    const bool          is_64       = header[4] == 2;
+    const std::uint64_t table       = is_64 ? readHostOrder<std::uint64_t>(header + 0x28) : readHostOrder<std::uint32_t>(header + 0x20);
+    const std::uint16_t entry_size  = readHostOrder<std::uint16_t>(header + (is_64 ? 0x3a : 0x2e));
+    const std::uint16_t entry_count = readHostOrder<std::uint16_t>(header + (is_64 ? 0x3c : 0x30));
+    // more than 0xff00 sections (entry_count == 0) are not supported
+    if (entry_count == 0 || entry_size < (is_64 ? 64 : 40) || table > file_length || (file_length - table) / entry_size < entry_count)
+        return false;
+
+    std::vector<unsigned char> entries(static_cast<std::size_t>(entry_count) * entry_size);
+    file.seekg(static_cast<std::streamoff>(table), std::ios::beg);
+    if (!file.read(reinterpret_cast<char*>(entries.data()), static_cast<std::streamsize>(entries.size()))) // NOLINT
+        return false;
+
+    const std::uint64_t sht_progbits  = 1;
+    const std::uint64_t shf_write     = 0x1;
+    const std::uint64_t shf_alloc     = 0x2;
+    const std::uint64_t shf_execinstr = 0x4;
+
+    ranges.clear();
+    for (std::size_t i = 0; i < entry_count; ++i) {
+        const unsigned char* entry = entries.data() + i * entry_size;
+        const std::uint64_t  type  = readHostOrder<std::uint32_t>(entry + 4);
+        const std::uint64_t  flags = is_64 ? readHostOrder<std::uint64_t>(entry + 8) : readHostOrder<std::uint32_t>(entry + 8);
+        const FileRange      range{is_64 ? readHostOrder<std::uint64_t>(entry + 24) : readHostOrder<std::uint32_t>(entry + 16),
+                                   is_64 ? readHostOrder<std::uint64_t>(entry + 32) : readHostOrder<std::uint32_t>(entry + 20)};
+
+        if (type != sht_progbits || (flags & (shf_write | shf_alloc | shf_execinstr)) != shf_alloc || range.size == 0)
+            continue;
+        if (range.offset > file_length || range.size > file_length - range.offset)
+            return false;
+        ranges.push_back(range);
+    }
+
+    std::sort(ranges.begin(), ranges.end(), [](const FileRange& a, const FileRange& b) { return a.offset < b.offset; });
+    std::vector<FileRange> merged;
+    for (const auto& range : ranges) {
+        if (!merged.empty() && merged.back().offset + merged.back().size >= range.offset)
+            merged.back().size = std::max(merged.back().size, range.offset + range.size - merged.back().offset);
+        else
+            merged.push_back(range);
+    }
+    ranges = std::move(merged);
+
+    return !ranges.empty();
+}
+
+void extension_system::parallelFor(std::size_t count, std::size_t threads, const std::function<void(std::size_t index)>& func) {
+    std::atomic<std::size_t> next{0};
+    const auto               work = [&] {
+        for (auto i = next++; i < count; i = next++)
+            func(i);
+    };
+
+    std::vector<std::thread> workers;
+    for (std::size_t i = 1; i < threads && i < count; ++i)
+        workers.emplace_back(work);
+    work();
+    for (auto& w : workers)
+        w.join();
+}
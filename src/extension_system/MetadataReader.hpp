@@ -0,0 +1,62 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace extension_system {
+
+/**
+ * Copies all metadata sections (start tag until end tag) of a file to sections.
+ * The file is memory mapped if Boost is available, otherwise it is read in chunks of chunk_size bytes.
+ * Only the sections are kept, the memory used doesn't depend on the size of the file.
+ * Start tags without end tag and descriptions longer than 1 MiB are skipped, a single start tag is appended after all sections instead
+ * so the parser reports the missing end tag.
+ * Can be called from multiple threads, each thread needs its own buffer.
+ * @return false if the file couldn't be read, error contains the reason
+ */
+bool readMetadataSections(const std::string& filename,
+                          const std::string& start_tag,
+                          const std::string& end_tag,
+                          std::size_t        chunk_size,
+                          std::vector<char>& buffer,
+                          std::vector<char>& sections,
+                          std::string&       error);
+
+/// a part of a file
+struct FileRange final {
+    std::uint64_t offset;
+    std::uint64_t size;
+};
+
+/**
+ * Like readMetadataSections, but only the given ranges of the file are searched.
+ * Sections spanning two ranges are not found.
+ */
+bool readMetadataSections(const std::string&            filename,
+                          const std::vector<FileRange>& ranges,
+                          const std::string&            start_tag,
+                          const std::string&            end_tag,
+                          std::size_t                   chunk_size,
+                          std::vector<char>&            buffer,
+                          std::vector<char>&            sections,
+                          std::string&                  error);
+
+/**
+ * Finds the parts of an ELF file that are loaded read-only and contain neither code nor writable data (.rodata, .eh_frame, ...).
+ * String literals and therefore the metadata of extensions are placed there, code and debug information are skipped.
+ * Adjacent sections are merged into one range.
+ * @return false if the file isn't an ELF file with the byte order of the host or if its section headers are invalid
+ */
+bool findReadOnlyDataSections(const std::string& filename, std::vector<FileRange>& ranges);
+
+/**
+ * Calls func for all indices in [0, count) using up to threads threads, the calling thread is one of them.
+ * Returns after all calls finished, func must not throw.
+ */
+void parallelFor(std::size_t count, std::size_t threads, const std::function<void(std::size_t index)>& func);
+}
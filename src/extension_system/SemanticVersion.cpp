@@ -0,0 +1,229 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#include "SemanticVersion.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+
+using namespace extension_system;
+
+namespace {
+using Interval = VersionRange::Interval;
+
+const Interval every_version{SemanticVersion{0, 0, 0}, SemanticVersion{0, 0, 0}, false};
+const Interval no_version{SemanticVersion{0, 0, 0}, SemanticVersion{0, 0, 0}, true};
+
+// a version with up to 3 given parts ("1", "1.2", "1.x", "*"), missing parts and wildcards are 0
+struct PartialVersion final {
+    SemanticVersion version;
+    std::size_t     parts;
+};
+
+std::uint32_t* part(SemanticVersion& version, std::size_t index) {
+    return index == 0 ? &version.major_version : index == 1 ? &version.minor_version : &version.patch_version;
+}
+
+bool parseNumber(const char*& p, const char* end, std::uint32_t& value) {
+    if (p == end || *p < '0' || *p > '9')
+        return false;
+
+    std::uint64_t result = 0;
+    for (; p != end && *p >= '0' && *p <= '9'; ++p) {
+        result = result * 10 + static_cast<std::uint64_t>(*p - '0');
+        if (result > 0xffffffffULL)
+            return false;
+    }
+    value = static_cast<std::uint32_t>(result);
+    return true;
+}
+
+bool parsePartial(const std::string& str, PartialVersion& result) {
+    result = PartialVersion{SemanticVersion{0, 0, 0}, 0};
+
+    const char* p        = str.data();
+    const char* end      = p + str.size();
+    bool        wildcard = false;
+    for (std::size_t i = 0; i < 3 && p != end; ++i) {
+        if (i != 0 && *p++ != '.')
+            return false;
+
+        if (p != end && (*p == 'x' || *p == 'X' || *p == '*')) {
+            wildcard = true;
+            ++p;
+        } else if (wildcard || !parseNumber(p, end, *part(result.version, i))) {
+            return false; // only wildcards can follow a wildcard
+        } else {
+            result.parts = i + 1;
+        }
+    }
+    return p == end;
+}
+
+/**
+ * The smallest version whose first parts parts are greater than those of version, e.g. 1.3.0 for 1.2 and 2.0.0 for 1
+ * @return false if parts is 0 or there is no such version
+ */
+bool nextVersion(const SemanticVersion& version, std::size_t parts, SemanticVersion& result) {
+    result = version;
+    for (std::size_t i = parts; i < 3; ++i)
+        *part(result, i) = 0;
+
+    for (std::size_t i = parts; i > 0; --i) {
+        auto* p = part(result, i - 1);
+        if (*p != 0xffffffffU) {
+            ++*p;
+            return true;
+        }
+        *p = 0; // carry
+    }
+    return false;
+}
+
+Interval upTo(const SemanticVersion& lower, const SemanticVersion& version, std::size_t parts) {
+    Interval result{lower, {}, false};
+    result.bounded = nextVersion(version, parts, result.upper);
+    return result;
+}
+
+bool parseComparator(const std::string& token, Interval& result) {
+    static const char* const operators[] = {">=", "<=", ">", "<", "=", "^", "~"};
+
+    std::string op;
+    for (const auto* o : operators) {
+        if (token.compare(0, std::strlen(o), o) == 0) {
+            op = o;
+            break;
+        }
+    }
+
+    PartialVersion partial{};
+    if (token.size() == op.size() || !parsePartial(token.substr(op.size()), partial))
+        return false;
+    const auto& version = partial.version;
+
+    if (op.empty() || op == "=") {
+        result = upTo(version, version, partial.parts);
+    } else if (op == ">=") {
+        result = Interval{version, {}, false};
+    } else if (op == ">") {
+        result = Interval{{}, {}, false};
+        if (!nextVersion(version, partial.parts, result.lower))
+            result = no_version;
+    } else if (op == "<") {
+        result = partial.parts == 0 ? no_version : Interval{SemanticVersion{0, 0, 0}, version, true};
+    } else if (op == "<=") {
+        result = upTo(SemanticVersion{0, 0, 0}, version, partial.parts);
+    } else if (op == "~") {
+        // same minor version, or same major version if only the major version is given
+        result = upTo(version, version, std::min<std::size_t>(partial.parts, 2));
+    } else {
+        // the first non-zero part has to stay the same
+        std::size_t parts = 0;
+        while (parts + 1 < partial.parts && *part(partial.version, parts) == 0)
+            ++parts;
+        result = upTo(version, version, partial.parts == 0 ? 0 : parts + 1);
+    }
+    return true;
+}
+
+void intersect(Interval& a, const Interval& b) {
+    a.lower = std::max(a.lower, b.lower);
+    if (b.bounded && (!a.bounded || b.upper < a.upper))
+        a.upper = b.upper;
+    a.bounded = a.bounded || b.bounded;
+}
+
+bool isEmpty(const Interval& interval) {
+    return interval.bounded && interval.upper <= interval.lower;
+}
+
+std::vector<std::string> splitWhitespace(const std::string& str) {
+    std::vector<std::string> result;
+    const auto               is_space = [](char c) { return std::isspace(static_cast<unsigned char>(c)) != 0; };
+    auto                     begin    = str.begin();
+    while (true) {
+        begin = std::find_if_not(begin, str.end(), is_space);
+        if (begin == str.end())
+            return result;
+        const auto end = std::find_if(begin, str.end(), is_space);
+        result.emplace_back(begin, end);
+        begin = end;
+    }
+}
+
+bool parseAlternative(const std::string& str, Interval& result) {
+    auto tokens = splitWhitespace(str);
+
+    // an operator followed by a space (">= 1.2") belongs to the next token
+    for (std::size_t i = 0; i + 1 < tokens.size(); ++i) {
+        if (tokens[i].find_first_not_of("<>=^~") == std::string::npos && tokens[i + 1] != "-") {
+            tokens[i] += tokens[i + 1];
+            tokens.erase(tokens.begin() + static_cast<std::ptrdiff_t>(i) + 1);
+        }
+    }
+
+    result = every_version;
+
+    // hyphen range, both versions are included
+    if (tokens.size() == 3 && tokens[1] == "-") {
+        PartialVersion lower{};
+        PartialVersion upper{};
+        if (!parsePartial(tokens[0], lower) || !parsePartial(tokens[2], upper))
+            return false;
+        result = upTo(lower.version, upper.version, upper.parts);
+        return true;
+    }
+
+    for (const auto& token : tokens) {
+        Interval interval{};
+        if (token == "-" || !parseComparator(token, interval))
+            return false;
+        intersect(result, interval);
+    }
+    return true;
+}
+} // namespace
+
+bool SemanticVersion::parse(const char* str, std::size_t length, SemanticVersion& version) {
+    PartialVersion partial{};
+    const auto*    end = str + length;
+    // wildcards aren't allowed
+    if (std::find_if(str, end, [](char c) { return c == 'x' || c == 'X' || c == '*'; }) != end || !parsePartial({str, length}, partial)
+        || partial.parts != 3)
+        return false;
+    version = partial.version;
+    return true;
+}
+
+VersionRange::VersionRange()
+    : m_intervals{every_version}
+    , m_valid{true} {}
+
+VersionRange::VersionRange(const char* range)
+    : VersionRange{std::string{range == nullptr ? "" : range}} {}
+
+VersionRange::VersionRange(const std::string& range)
+    : m_range{range}
+    , m_valid{true} {
+    for (std::size_t begin = 0;;) {
+        const auto end = range.find("||", begin);
+
+        Interval interval{};
+        if (!parseAlternative(range.substr(begin, end == std::string::npos ? std::string::npos : end - begin), interval)) {
+            m_valid = false;
+            m_intervals.clear();
+            return;
+        }
+        if (!isEmpty(interval))
+            m_intervals.push_back(interval);
+
+        if (end == std::string::npos)
+            return;
+        begin = end + 2;
+    }
+}
+
+bool VersionRange::contains(const SemanticVersion& version) const {
+    return std::any_of(m_intervals.begin(), m_intervals.end(), [&](const Interval& i) { return i.contains(version); });
+}
@@ -0,0 +1,109 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <tuple>
+#include <vector>
+
+namespace extension_system {
+
+/**
+ * Version of an extension in the form major.minor.patch.
+ * Extensions export it with EXTENSION_SYSTEM_SEMANTIC_VERSION_ENTRY, extensions without it have the semantic version version.0.0.
+ * Pre-release and build suffixes ("1.2.3-beta", "1.2.3+42") are not supported.
+ */
+struct SemanticVersion final {
+    // not called major and minor, old C libraries define macros with these names
+    std::uint32_t major_version;
+    std::uint32_t minor_version;
+    std::uint32_t patch_version;
+
+    /**
+     * Parses "major.minor.patch", every part is a decimal number that fits into 32 bits
+     * @return false if str (not null-terminated) isn't a valid version, version is unchanged in this case
+     */
+    static bool parse(const char* str, std::size_t length, SemanticVersion& version);
+
+    std::string toString() const {
+        return std::to_string(major_version) + "." + std::to_string(minor_version) + "." + std::to_string(patch_version);
+    }
+};
+
+inline bool operator<(const SemanticVersion& a, const SemanticVersion& b) {
+    return std::tie(a.major_version, a.minor_version, a.patch_version) < std::tie(b.major_version, b.minor_version, b.patch_version);
+}
+
+inline bool operator==(const SemanticVersion& a, const SemanticVersion& b) {
+    return a.major_version == b.major_version && a.minor_version == b.minor_version && a.patch_version == b.patch_version;
+}
+
+inline bool operator!=(const SemanticVersion& a, const SemanticVersion& b) {
+    return !(a == b);
+}
+
+inline bool operator>(const SemanticVersion& a, const SemanticVersion& b) {
+    return b < a;
+}
+
+inline bool operator<=(const SemanticVersion& a, const SemanticVersion& b) {
+    return !(b < a);
+}
+
+inline bool operator>=(const SemanticVersion& a, const SemanticVersion& b) {
+    return !(a < b);
+}
+
+/**
+ * A set of semantic versions, e.g. ">=1.2 <2", "^1.4.2 || ~2.0" or "1.x".
+ * Comparators separated by spaces have to be fulfilled all, alternatives are separated by "||".
+ * Supported are "<", "<=", ">", ">=", "=", "^" (compatible: same major version, or same minor version for 0.x), "~" (same minor version),
+ * partial versions and wildcards ("1.2", "1.x", "*") and hyphen ranges ("1.2 - 1.4").
+ * Partial versions are completed like npm does: ">1.2" means ">=1.3.0" and "<=1.2" means "<1.3.0".
+ * An empty range matches every version.
+ */
+class VersionRange final {
+public:
+    /// the versions [lower, upper), upper is ignored if bounded is false
+    struct Interval final {
+        SemanticVersion lower;
+        SemanticVersion upper;
+        bool            bounded;
+
+        bool contains(const SemanticVersion& version) const {
+            return lower <= version && (!bounded || version < upper);
+        }
+    };
+
+    /// matches every version
+    VersionRange();
+
+    /// parses range, use isValid to check if it could be parsed
+    VersionRange(const std::string& range); // NOLINT(google-explicit-constructor)
+    VersionRange(const char* range);        // NOLINT(google-explicit-constructor)
+
+    /// @returns false if the range couldn't be parsed, invalid ranges don't match any version
+    bool isValid() const {
+        return m_valid;
+    }
+
+    bool contains(const SemanticVersion& version) const;
+
+    /// the alternatives of the range, each one is a single interval, empty alternatives are dropped
+    const std::vector<Interval>& intervals() const {
+        return m_intervals;
+    }
+
+    /// the range as it was given
+    const std::string& toString() const {
+        return m_range;
+    }
+
+private:
+    std::string           m_range;
+    std::vector<Interval> m_intervals;
+    bool                  m_valid;
+};
+}
@@ -0,0 +1,105 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#ifdef EXTENSION_SYSTEM_USE_BOOST
+#include <boost/algorithm/searching/boyer_moore.hpp>
+#endif
+
+namespace extension_system {
+
+#ifdef EXTENSION_SYSTEM_USE_BOOST
+using StringSearch = boost::algorithm::boyer_moore<const char*>;
+#else
+class StringSearch final {
+public:
+    StringSearch(const char* pattern_first, const char* pattern_last)
+        : _pattern_first(pattern_first)
+        , _pattern_last(pattern_last) { }
+
+    const char* operator()(const char* first, const char* last) const {
+        // HINT: memmem is much slower than std::search
+        return std::search(first, last, _pattern_first, _pattern_last);
+    }
+
+private:
+    const char* _pattern_first;
+    const char* _pattern_last;
+};
+#endif
+
+// boost broke compatibility
+// https://svn.boost.org/trac/boost/ticket/12552
+template <typename corpusIter>
+inline corpusIter getFirstFromPair(const std::pair<corpusIter, corpusIter>& p) {
+    return p.first;
+}
+template <typename corpusIter>
+inline corpusIter getFirstFromPair(corpusIter p) {
+    return p;
+}
+
+/**
+ * Finds the start and end tags of descriptions in a single pass.
+ * Both tags begin with the same prefix (EXTENSION_SYSTEM_METADATA_DESCRIPTION_), only the prefix is searched and the following
+ * characters decide which tag was found. The tags have to outlive the scanner.
+ */
+class MarkerScanner final {
+public:
+    enum class Kind {
+        Start,
+        End
+    };
+
+    struct Marker final {
+        const char* position; ///< first character of the tag, last if no tag was found
+        Kind        kind;
+    };
+
+    MarkerScanner(const std::string& start_tag, const std::string& end_tag)
+        : m_start_tag{start_tag}
+        , m_end_tag{end_tag}
+        , m_prefix_length{static_cast<std::size_t>(
+              std::mismatch(start_tag.begin(), start_tag.begin() + std::min(start_tag.length(), end_tag.length()), end_tag.begin()).first
+              - start_tag.begin())}
+        , m_search_prefix{start_tag.c_str(), start_tag.c_str() + m_prefix_length} { }
+
+    /// @returns the first tag in [first, last)
+    Marker next(const char* first, const char* last) const {
+        for (const char* p = getFirstFromPair(m_search_prefix(first, last)); p != last; p = getFirstFromPair(m_search_prefix(p + 1, last))) {
+            if (isTag(p, last, m_start_tag))
+                return {p, Kind::Start};
+            if (isTag(p, last, m_end_tag))
+                return {p, Kind::End};
+        }
+        return {last, Kind::Start};
+    }
+
+    /// appends all tags in [first, last) to markers
+    void findAll(const char* first, const char* last, std::vector<Marker>& markers) const {
+        for (auto m = next(first, last); m.position != last; m = next(m.position + m_prefix_length, last))
+            markers.push_back(m);
+    }
+
+    std::size_t length(Kind kind) const {
+        return kind == Kind::Start ? m_start_tag.length() : m_end_tag.length();
+    }
+
+private:
+    bool isTag(const char* p, const char* last, const std::string& tag) const {
+        return static_cast<std::size_t>(last - p) >= tag.length()
+               && std::memcmp(p + m_prefix_length, tag.data() + m_prefix_length, tag.length() - m_prefix_length) == 0;
+    }
+
+    const std::string& m_start_tag;
+    const std::string& m_end_tag;
+    const std::size_t  m_prefix_length;
+    StringSearch       m_search_prefix;
+};
+}
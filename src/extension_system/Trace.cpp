@@ -0,0 +1,97 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#include "Trace.hpp"
+
+#include <atomic>
+#include <cstdio>
+
+using namespace extension_system;
+
+namespace {
+std::mutex                 sink_mutex;
+std::shared_ptr<TraceSink> sink;
+std::atomic<bool>          sink_set{false}; // avoids locking the mutex for every span if tracing is not used
+
+std::string escapeJson(const std::string& str) {
+    std::string result;
+    result.reserve(str.size());
+    for (const char c : str) {
+        switch (c) {
+            case '"':
+                result += "\\\"";
+                break;
+            case '\\':
+                result += "\\\\";
+                break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char buffer[8];
+                    (void)std::snprintf(buffer, sizeof(buffer), "\\u%04x", static_cast<unsigned>(c));
+                    result += buffer;
+                } else {
+                    result += c;
+                }
+        }
+    }
+    return result;
+}
+} // namespace
+
+ChromeTraceSink::ChromeTraceSink(const std::string& filename)
+    : m_file{filename, std::ios::out | std::ios::trunc}
+    , m_start{std::chrono::steady_clock::now()} {
+    m_file << "{\"traceEvents\":[";
+}
+
+ChromeTraceSink::~ChromeTraceSink() noexcept {
+    m_file << "\n],\"displayTimeUnit\":\"ms\"}\n";
+}
+
+void ChromeTraceSink::write(const TraceSpan& span) {
+    using microseconds = std::chrono::duration<double, std::micro>;
+    const auto ts      = std::chrono::duration_cast<microseconds>(span.begin - m_start).count();
+    const auto dur     = std::chrono::duration_cast<microseconds>(span.end - span.begin).count();
+    const auto detail  = escapeJson(span.detail);
+
+    std::lock_guard<std::mutex> lock{m_mutex};
+    const auto                  tid = m_thread_ids.emplace(span.thread, static_cast<int>(m_thread_ids.size()) + 1).first->second;
+
+    m_file << (m_first ? "\n" : ",\n") << R"({"name":")" << span.name << R"(","cat":"extension_system","ph":"X","pid":1,"tid":)" << tid
+           << R"(,"ts":)" << ts << R"(,"dur":)" << dur << R"(,"args":{"detail":")" << detail << "\"}}";
+    m_first = false;
+}
+
+void extension_system::setTraceSink(std::shared_ptr<TraceSink> new_sink) {
+    std::lock_guard<std::mutex> lock{sink_mutex};
+    sink_set = new_sink != nullptr;
+    sink     = std::move(new_sink);
+}
+
+std::shared_ptr<TraceSink> extension_system::getTraceSink() {
+    if (!sink_set)
+        return {};
+    std::lock_guard<std::mutex> lock{sink_mutex};
+    return sink;
+}
+
+TraceScope::TraceScope(const char* name, const std::string& detail)
+    : m_sink{getTraceSink()}
+    , m_name{name} {
+    if (m_sink == nullptr)
+        return;
+    m_detail = detail;
+    m_begin  = std::chrono::steady_clock::now();
+}
+
+void TraceScope::end() noexcept {
+    if (m_sink == nullptr)
+        return;
+
+    const TraceSpan span{m_name, m_detail, m_begin, std::chrono::steady_clock::now(), std::this_thread::get_id()};
+    try {
+        m_sink->write(span);
+    } catch (...) {
+        // tracing must not change the behavior of the ExtensionSystem
+    }
+    m_sink.reset();
+}
@@ -0,0 +1,109 @@
+/// SPDX-FileCopyrightText: 2014-2020 Bernd Amend and Michael Adam
+/// SPDX-License-Identifier: BSL-1.0
+#pragma once
+
+#include <chrono>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace extension_system {
+
+/**
+ * A timed section within the ExtensionSystem, e.g. scanning a library or instantiating an extension.
+ * Spans of the same thread are nested, an outer span ends after all spans started within it.
+ */
+struct TraceSpan final {
+    const char*                           name;   ///< e.g. "addDynamicLibrary", "dlopen" or "construct"
+    const std::string&                    detail; ///< the library or directory the span belongs to
+    std::chrono::steady_clock::time_point begin;
+    std::chrono::steady_clock::time_point end;
+    std::thread::id                       thread;
+};
+
+/**
+ * Receives the spans of all ExtensionSystem instances
+ * write is called from all threads that use an ExtensionSystem or destroy extensions, it has to be thread-safe.
+ */
+class TraceSink {
+public:
+    TraceSink()                 = default;
+    TraceSink(TraceSink&&)      = delete;
+    TraceSink(const TraceSink&) = delete;
+    TraceSink& operator=(TraceSink&&) = delete;
+    TraceSink& operator=(const TraceSink&) = delete;
+    virtual ~TraceSink() noexcept          = default;
+
+    virtual void write(const TraceSpan& span) = 0;
+};
+
+/**
+ * Writes the spans as Chrome trace-event JSON, the file can be opened with chrome://tracing or https://ui.perfetto.dev
+ * The file is completed when the sink is destroyed.
+ */
+class ChromeTraceSink final : public TraceSink {
+public:
+    explicit ChromeTraceSink(const std::string& filename);
+    ChromeTraceSink(ChromeTraceSink&&)      = delete;
+    ChromeTraceSink(const ChromeTraceSink&) = delete;
+    ChromeTraceSink& operator=(ChromeTraceSink&&) = delete;
+    ChromeTraceSink& operator=(const ChromeTraceSink&) = delete;
+    ~ChromeTraceSink() noexcept override;
+
+    bool isOpen() const {
+        return m_file.is_open();
+    }
+
+    void write(const TraceSpan& span) override;
+
+private:
+    std::mutex                               m_mutex;
+    std::ofstream                            m_file;
+    std::chrono::steady_clock::time_point    m_start;
+    std::unordered_map<std::thread::id, int> m_thread_ids;
+    bool                                     m_first = true;
+};
+
+/**
+ * Sets the sink that receives all spans, nullptr disables tracing
+ * Spans are only emitted if the library and the code using it were built with EXTENSION_SYSTEM_ENABLE_TRACING.
+ */
+void setTraceSink(std::shared_ptr<TraceSink> sink);
+
+std::shared_ptr<TraceSink> getTraceSink();
+
+/**
+ * Emits a span from its construction until end() is called or it is destroyed
+ * Use the EXTENSION_SYSTEM_TRACE_* macros instead, they compile to nothing if tracing is disabled.
+ */
+class TraceScope final {
+public:
+    TraceScope(const char* name, const std::string& detail);
+    TraceScope(TraceScope&&)      = delete;
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(TraceScope&&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+    ~TraceScope() noexcept {
+        end();
+    }
+
+    void end() noexcept;
+
+private:
+    std::shared_ptr<TraceSink>            m_sink; // nullptr if no sink was set or the span already ended
+    const char*                           m_name;
+    std::string                           m_detail;
+    std::chrono::steady_clock::time_point m_begin;
+};
+}
+
+#ifdef EXTENSION_SYSTEM_ENABLE_TRACING
+#define EXTENSION_SYSTEM_TRACE_SCOPE(var, name, detail) ::extension_system::TraceScope var{name, detail}
+#define EXTENSION_SYSTEM_TRACE_END(var) var.end()
+#else
+#define EXTENSION_SYSTEM_TRACE_SCOPE(var, name, detail) (void)0
+#define EXTENSION_SYSTEM_TRACE_END(var) (void)0
+#endif
@@ -2,6 +2,12 @@
 /// SPDX-License-Identifier: BSL-1.0
 #include "filesystem.hpp"
 
+#include <set>
+
+#ifdef EXTENSION_SYSTEM_USE_STD_FILESYSTEM
+#include <random>
+#endif
+
 #ifdef EXTENSION_SYSTEM_USE_STD_FILESYSTEM
 using namespace extension_system::filesystem;
 
@@ -11,10 +17,58 @@ path extension_system::filesystem::canonical(const path& p) {
 }
 #endif
 
-void extension_system::filesystem::forEachFileInDirectory(const path& root, const std::function<void(const path& p)>& func, bool recursive) {
-    if (!exists(root) && !is_directory(root)) {
-        return;
+bool extension_system::filesystem::get_file_stamp(const path& p, file_stamp& stamp) {
+    std::error_code ec;
+    const auto      size = file_size(p, ec);
+    if (ec)
+        return false;
+    const auto time = last_write_time(p, ec);
+    if (ec)
+        return false;
+    stamp                   = {};
+    stamp.size              = static_cast<std::uint64_t>(size);
+    stamp.modification_time = static_cast<std::int64_t>(time.time_since_epoch().count());
+    return true;
+}
+
+path extension_system::filesystem::make_private_copy(const path& from) {
+    // the temporary directory of a user is private on Windows, a new directory avoids collisions with other processes
+    std::error_code ec;
+    std::random_device random;
+    for (int attempt = 0; attempt < 100; ++attempt) {
+        const auto dir = temporary_directory() / ("extension_system_" + std::to_string(random()));
+        if (!create_directory(dir, ec)) {
+            if (ec)
+                return {};
+            continue; // already exists
+        }
+        const auto to = dir / from.filename();
+        if (copy_file(from, to, copy_options::none, ec) && !ec)
+            return to;
+        remove_all(dir, ec);
+        return {};
     }
+    return {};
+}
+
+bool extension_system::filesystem::remove_private_copy(const path& copy) {
+    std::error_code ec;
+    const bool      removed = remove(copy, ec);
+    return remove(copy.parent_path(), ec) && removed;
+}
+
+path extension_system::filesystem::temporary_directory() {
+    std::error_code ec;
+    return temp_directory_path(ec);
+}
+
+void extension_system::filesystem::forEachFileInDirectory(const path&                               root,
+                                                          const name_filter&                        filter,
+                                                          const std::function<void(const path& p)>& func,
+                                                          std::size_t                               max_depth) {
+    std::error_code ec;
+    if (!is_directory(root, ec))
+        return;
 
     auto options = directory_options::follow_directory_symlink;
 
@@ -22,29 +76,66 @@ void extension_system::filesystem::forEachFileInDirectory(const path& root, cons
     options |= directory_options::skip_permission_denied;
 #endif
 
-    if (recursive) {
-        recursive_directory_iterator end_iter;
-        for (recursive_directory_iterator dir_iter(root, options); dir_iter != end_iter; ++dir_iter) {
-            func(dir_iter->path());
+    // directories and files reached through symbolic links are only visited once, this also breaks loops
+    std::set<extension_system::filesystem::path> visited{canonical(root, ec)};
+    recursive_directory_iterator                 end_iter;
+    for (recursive_directory_iterator dir_iter(root, options); dir_iter != end_iter; ++dir_iter) {
+        const auto name   = dir_iter->path().filename().string();
+        const auto is_dir = dir_iter->is_directory(ec);
+        if (is_dir && (static_cast<std::size_t>(dir_iter.depth()) >= max_depth || !filter(name.c_str(), name.length(), true))) {
+            dir_iter.disable_recursion_pending();
+            continue;
         }
-    } else {
-        directory_iterator end_iter;
-        for (directory_iterator dir_iter(root); dir_iter != end_iter; ++dir_iter) {
-            func(dir_iter->path());
+        if (!is_dir && !filter(name.c_str(), name.length(), false))
+            continue;
+
+        const auto real = canonical(dir_iter->path(), ec);
+        if (!ec && !visited.insert(real).second) {
+            if (is_dir)
+                dir_iter.disable_recursion_pending();
+            continue;
         }
+        if (!is_dir)
+            func(dir_iter->path());
     }
 }
 
+bool extension_system::filesystem::path_resolver::resolve(const path& p, std::string& real_path, file_stamp& stamp, bool& is_directory) {
+    std::error_code ec;
+    if (!exists(p, ec) || !get_file_stamp(p, stamp))
+        return false;
+    real_path    = canonical(p).generic_string();
+    is_directory = filesystem::is_directory(p, ec);
+    return true;
+}
+
+std::string extension_system::filesystem::path_resolver::directory(const path& dir) {
+    return canonical(dir).generic_string();
+}
+
 #else
 
 #include <array>
+#include <cerrno>
 #include <climits>
 #include <cstdlib>
+#include <cstdio>
+#include <cstring>
 #include <dirent.h>
+#include <fcntl.h>
+#include <memory>
 #include <sys/stat.h>
 #include <sys/types.h>
 #include <unistd.h>
 
+#ifdef __MINGW32__
+#include <io.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#endif
+
 bool extension_system::filesystem::exists(const extension_system::filesystem::path& p) {
     const std::string str = p.string();
     return access(str.c_str(), F_OK) == 0;
@@ -70,30 +161,350 @@ extension_system::filesystem::path extension_system::filesystem::canonical(const
 #endif
 }
 
+namespace {
+void toFileStamp(const struct stat& sb, extension_system::filesystem::file_stamp& stamp) {
+    stamp.device = static_cast<std::uint64_t>(sb.st_dev);
+    stamp.inode  = static_cast<std::uint64_t>(sb.st_ino);
+    stamp.size   = static_cast<std::uint64_t>(sb.st_size);
+#if defined(__APPLE__)
+    stamp.modification_time = static_cast<std::int64_t>(sb.st_mtimespec.tv_sec) * 1000000000 + sb.st_mtimespec.tv_nsec;
+#elif defined(__MINGW32__)
+    stamp.modification_time = static_cast<std::int64_t>(sb.st_mtime) * 1000000000;
+#else
+    stamp.modification_time = static_cast<std::int64_t>(sb.st_mtim.tv_sec) * 1000000000 + sb.st_mtim.tv_nsec;
+#endif
+}
+} // namespace
+
+bool extension_system::filesystem::get_file_stamp(const extension_system::filesystem::path& p, file_stamp& stamp) {
+    const auto  str = p.string();
+    struct stat sb { };
+    if (stat(str.c_str(), &sb) != 0)
+        return false;
+    toFileStamp(sb, stamp);
+    return true;
+}
+
+bool extension_system::filesystem::path_resolver::resolve(const path& p, std::string& real_path, file_stamp& stamp, bool& is_directory) {
+    const auto  str = p.string();
+    struct stat sb { };
+#ifdef __MINGW32__
+    if (stat(str.c_str(), &sb) != 0)
+        return false;
+    const bool is_link = false;
+#else
+    if (lstat(str.c_str(), &sb) != 0)
+        return false;
+    const bool is_link = S_ISLNK(sb.st_mode);
+#endif
+
+    const auto name = p.filename().string();
+    if (is_link || name.empty() || name == "." || name == "..") {
+        if (stat(str.c_str(), &sb) != 0)
+            return false; // dangling symbolic link
+        real_path = canonical(p).string();
+    } else {
+        real_path = directory(p.parent_path());
+        if (real_path.empty() || real_path.back() != '/')
+            real_path += '/';
+        real_path += name;
+    }
+
+    toFileStamp(sb, stamp);
+    is_directory = S_ISDIR(sb.st_mode);
+    return true;
+}
+
+std::string extension_system::filesystem::path_resolver::directory(const path& dir) {
+    const auto name = dir.string().empty() ? std::string{"."} : dir.string();
+    {
+        std::lock_guard<std::mutex> lock{m_mutex};
+        const auto                  iter = m_directories.find(name);
+        if (iter != m_directories.end())
+            return iter->second;
+    }
+
+    // resolved without holding the lock, concurrent calls for the same directory resolve it twice
+    auto real_path = canonical(name).string();
+    std::lock_guard<std::mutex> lock{m_mutex};
+    return m_directories.emplace(name, std::move(real_path)).first->second;
+}
+
+namespace {
+bool copyFile(const std::string& from, const std::string& to) {
+#ifdef __MINGW32__
+    const int in  = open(from.c_str(), O_RDONLY | O_BINARY);
+    const int out = in < 0 ? -1 : open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_BINARY, S_IRUSR | S_IWUSR);
+#else
+    // O_EXCL and O_NOFOLLOW: never write through a file or symbolic link that already exists
+    const int in  = open(from.c_str(), O_RDONLY | O_CLOEXEC);
+    const int out = in < 0 ? -1 : open(to.c_str(), O_WRONLY | O_CREAT | O_EXCL | O_NOFOLLOW | O_CLOEXEC, S_IRUSR | S_IWUSR);
+#endif
+    if (out < 0) {
+        if (in >= 0)
+            (void)close(in);
+        return false;
+    }
+
+    std::array<char, 64 * 1024> buffer{};
+    bool                        successful = true;
+    while (successful) {
+        const auto count = read(in, buffer.data(), buffer.size());
+        if (count < 0 && errno == EINTR)
+            continue;
+        if (count <= 0) {
+            successful = count == 0;
+            break;
+        }
+        for (ssize_t written = 0; written < count;) {
+            const auto n = write(out, buffer.data() + written, static_cast<std::size_t>(count - written));
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0) {
+                successful = false;
+                break;
+            }
+            written += n;
+        }
+    }
+
+    (void)close(in);
+    successful = close(out) == 0 && successful;
+    return successful;
+}
+} // namespace
+
+extension_system::filesystem::path extension_system::filesystem::make_private_copy(const extension_system::filesystem::path& from) {
+    // a new directory that only the current user can access, its name isn't predictable
+    auto dir = (temporary_directory() / "extension_system_XXXXXX").string();
+#ifdef __MINGW32__
+    if (_mktemp(&dir[0]) == nullptr || mkdir(dir.c_str()) != 0)
+        return {};
+#else
+    if (mkdtemp(&dir[0]) == nullptr)
+        return {};
+#endif
+
+    const auto to = (path{dir} / from.filename()).string();
+    if (!copyFile(from.string(), to)) {
+        (void)std::remove(to.c_str());
+        (void)rmdir(dir.c_str());
+        return {};
+    }
+    return to;
+}
+
+bool extension_system::filesystem::remove_private_copy(const extension_system::filesystem::path& copy) {
+    const auto file    = copy.string();
+    const auto dir     = copy.parent_path().string();
+    const bool removed = std::remove(file.c_str()) == 0;
+    return rmdir(dir.c_str()) == 0 && removed;
+}
+
+extension_system::filesystem::path extension_system::filesystem::temporary_directory() {
+    const char* dir = std::getenv("TMPDIR");
+    if (dir == nullptr || *dir == '\0')
+        dir = "/tmp";
+    return std::string{dir};
+}
+
+namespace {
+// device and inode, identifies a directory or file independent of the symbolic links or bind mounts it is reached through
+using FileId = std::pair<std::uint64_t, std::uint64_t>;
+
+FileId fileId(const struct stat& sb) {
+    return FileId{static_cast<std::uint64_t>(sb.st_dev), static_cast<std::uint64_t>(sb.st_ino)};
+}
+} // namespace
+
+#ifdef __linux__
+namespace {
+// layout of the records returned by getdents64, glibc only declares it with _GNU_SOURCE since 2.30
+struct linux_dirent64 {
+    std::uint64_t  d_ino;
+    std::int64_t   d_off;
+    unsigned short d_reclen;
+    unsigned char  d_type;
+    char           d_name[1];
+};
+
+// an open directory whose entries are read in large batches using getdents64
+class DirectoryReader final {
+public:
+    DirectoryReader(int parent_fd, const char* name, std::string path)
+        : m_fd{openat(parent_fd, name, O_RDONLY | O_DIRECTORY | O_CLOEXEC)}
+        , m_path{std::move(path)} {
+        struct stat sb { };
+        if (m_fd >= 0 && fstat(m_fd, &sb) == 0)
+            m_id = fileId(sb);
+    }
+    DirectoryReader(DirectoryReader&&)      = delete;
+    DirectoryReader(const DirectoryReader&) = delete;
+    DirectoryReader& operator=(DirectoryReader&&) = delete;
+    DirectoryReader& operator=(const DirectoryReader&) = delete;
+    ~DirectoryReader() noexcept {
+        if (m_fd >= 0)
+            (void)close(m_fd);
+    }
+
+    bool isOpen() const {
+        return m_fd >= 0;
+    }
+
+    int fd() const {
+        return m_fd;
+    }
+
+    const std::string& path() const {
+        return m_path;
+    }
+
+    const FileId& id() const {
+        return m_id;
+    }
+
+    /// @returns nullptr after the last entry or if the directory couldn't be read
+    const linux_dirent64* next() {
+        if (m_pos >= m_size) {
+            if (m_buffer == nullptr)
+                m_buffer.reset(new std::uint64_t[buffer_size / sizeof(std::uint64_t)]); // getdents64 records are 8 byte aligned
+            const auto read = syscall(SYS_getdents64, m_fd, m_buffer.get(), buffer_size);
+            if (read <= 0)
+                return nullptr;
+            m_pos  = 0;
+            m_size = static_cast<std::size_t>(read);
+        }
+
+        const auto* entry = reinterpret_cast<const linux_dirent64*>(reinterpret_cast<const char*>(m_buffer.get()) + m_pos); // NOLINT
+        m_pos += entry->d_reclen;
+        return entry;
+    }
+
+private:
+    static const std::size_t buffer_size = 32 * 1024;
+
+    int                              m_fd;
+    std::string                      m_path;
+    FileId                           m_id;
+    std::unique_ptr<std::uint64_t[]> m_buffer;
+    std::size_t                      m_pos{};
+    std::size_t                      m_size{};
+};
+} // namespace
+
+void extension_system::filesystem::forEachFileInDirectory(const extension_system::filesystem::path&                               root,
+                                                          const name_filter&                                                      filter,
+                                                          const std::function<void(const extension_system::filesystem::path& p)>& func,
+                                                          std::size_t max_depth) {
+    // directories are opened relative to their parent, d_type is trusted and only symbolic links and file systems that don't
+    // report the type (DT_UNKNOWN) need a stat to find out if they are a directory
+    std::vector<std::unique_ptr<DirectoryReader>> stack;
+    stack.push_back(std::unique_ptr<DirectoryReader>{new DirectoryReader{AT_FDCWD, root.string().c_str(), root.string()}});
+    if (!stack.back()->isOpen())
+        return;
+
+    // directories and files reached through symbolic links or bind mounts are only visited once, this also breaks loops
+    std::set<FileId> visited{stack.back()->id()};
+
+    std::string full_name;
+    while (!stack.empty()) {
+        auto&       dir   = *stack.back();
+        const auto* entry = dir.next();
+        if (entry == nullptr) {
+            stack.pop_back();
+            continue;
+        }
+
+        const char* name = entry->d_name;
+        if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+            continue;
+
+        // entries rejected by their name are neither stat'ed nor is their path built, the root is at depth 0
+        const auto length      = std::strlen(name);
+        const bool maybe_dir   = entry->d_type == DT_DIR || entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK;
+        const bool maybe_file  = entry->d_type == DT_REG || entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK;
+        const bool enter_dir   = maybe_dir && stack.size() <= max_depth && filter(name, length, true);
+        const bool report_file = maybe_file && filter(name, length, false);
+        if (!enter_dir && !report_file)
+            continue;
+
+        bool        is_dir = entry->d_type == DT_DIR;
+        struct stat sb { };
+        bool        has_stat = false;
+        if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK) {
+            has_stat = fstatat(dir.fd(), name, &sb, 0) == 0;
+            is_dir   = has_stat && S_ISDIR(sb.st_mode);
+        }
+
+        if (is_dir) {
+            if (!enter_dir)
+                continue;
+            full_name.assign(dir.path()).append(1, '/').append(name, length);
+            std::unique_ptr<DirectoryReader> sub_dir{new DirectoryReader{dir.fd(), name, full_name}};
+            if (sub_dir->isOpen() && visited.insert(sub_dir->id()).second)
+                stack.push_back(std::move(sub_dir));
+        } else if (report_file) {
+            // d_ino isn't reliable for files on overlay or bind mounts and may not belong to the device of the directory, the
+            // identity of regular files is stat'ed
+            if (!has_stat && fstatat(dir.fd(), name, &sb, AT_SYMLINK_NOFOLLOW) != 0)
+                continue;
+            if (!visited.insert(fileId(sb)).second)
+                continue;
+            full_name.assign(dir.path()).append(1, '/').append(name, length);
+            func(extension_system::filesystem::path{full_name});
+        }
+    }
+}
+#else
 void extension_system::filesystem::forEachFileInDirectory(const extension_system::filesystem::path&                               root,
+                                                          const name_filter&                                                      filter,
                                                           const std::function<void(const extension_system::filesystem::path& p)>& func,
-                                                          bool recursive) {
-    const std::function<void(const extension_system::filesystem::path& p)> handle_dir
-        = [&func, &recursive, &handle_dir](const extension_system::filesystem::path& p) {
-              const auto path_string = p.string();
-              auto*      dp          = opendir(path_string.c_str());
+                                                          std::size_t max_depth) {
+    // directories and files reached through symbolic links or bind mounts are only visited once, this also breaks loops
+    std::set<FileId> visited;
+
+    const std::function<void(const extension_system::filesystem::path& p, std::size_t depth)> handle_dir
+        = [&filter, &func, max_depth, &handle_dir, &visited](const extension_system::filesystem::path& p, std::size_t depth) {
+              const auto  path_string = p.string();
+              struct stat dir_sb { };
+              if (stat(path_string.c_str(), &dir_sb) != 0 || !visited.insert(fileId(dir_sb)).second)
+                  return;
+
+              auto* dp = opendir(path_string.c_str());
 
               if (dp != nullptr) {
                   dirent* ep{};
                   while ((ep = readdir(dp)) != nullptr) {
-                      const auto name      = std::string{ep->d_name};
-                      const auto full_name = p / name;
+                      const char* name = ep->d_name;
+                      if (std::strcmp(name, ".") == 0 || std::strcmp(name, "..") == 0)
+                          continue;
 
-                      if (name == "." || name == "..")
+                      // entries rejected by their name are neither stat'ed nor is their path built
+                      const auto length      = std::strlen(name);
+                      const bool maybe_dir   = ep->d_type == DT_DIR || ep->d_type == DT_UNKNOWN || ep->d_type == DT_LNK;
+                      const bool maybe_file  = ep->d_type == DT_REG || ep->d_type == DT_UNKNOWN || ep->d_type == DT_LNK;
+                      const bool enter_dir   = maybe_dir && depth < max_depth && filter(name, length, true);
+                      const bool report_file = maybe_file && filter(name, length, false);
+                      if (!enter_dir && !report_file)
                           continue;
 
-                      if (ep->d_type == DT_REG || ep->d_type == DT_UNKNOWN || ep->d_type == DT_LNK) {
-                          if (recursive && is_directory(full_name))
-                              handle_dir(full_name);
-                          else
+                      const auto full_name = p / std::string{name, length};
+
+                      bool        is_dir = ep->d_type == DT_DIR;
+                      struct stat sb { };
+                      bool        has_stat = false;
+                      if (ep->d_type == DT_UNKNOWN || ep->d_type == DT_LNK) {
+                          has_stat = fstatat(dirfd(dp), name, &sb, 0) == 0;
+                          is_dir   = has_stat && S_ISDIR(sb.st_mode);
+                      }
+
+                      if (is_dir) {
+                          if (enter_dir)
+                              handle_dir(full_name, depth + 1);
+                      } else if (report_file) {
+                          // d_ino isn't reliable for files on overlay or bind mounts, the identity of regular files is stat'ed
+                          if ((has_stat || fstatat(dirfd(dp), name, &sb, AT_SYMLINK_NOFOLLOW) == 0) && visited.insert(fileId(sb)).second)
                               func(full_name);
-                      } else if (recursive && ep->d_type == DT_DIR) {
-                          handle_dir(full_name);
                       }
                   }
 
@@ -103,7 +514,12 @@ void extension_system::filesystem::forEachFileInDirectory(const extension_system
               }
           };
 
-    handle_dir(root);
+    handle_dir(root, 0);
 }
-
 #endif
+#endif
+
+void extension_system::filesystem::forEachFileInDirectory(const path& root, const std::function<void(const path& p)>& func, bool recursive) {
+    forEachFileInDirectory(
+        root, [](const char*, std::size_t, bool) { return true; }, func, recursive ? static_cast<std::size_t>(-1) : 0);
+}
@@ -2,9 +2,12 @@
 /// SPDX-License-Identifier: BSL-1.0
 #pragma once
 
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <functional>
+#include <mutex>
+#include <unordered_map>
 
 #include "string.hpp"
 
@@ -50,6 +53,34 @@ using namespace std::filesystem;
 #endif
 // clang-format on
 
+/// identifies the state of a file, changes if the file is modified or replaced
+struct file_stamp final {
+    std::uint64_t device{};
+    std::uint64_t inode{};
+    std::uint64_t size{};
+    std::int64_t  modification_time{};
+
+    bool operator==(const file_stamp& rhs) const {
+        return device == rhs.device && inode == rhs.inode && size == rhs.size && modification_time == rhs.modification_time;
+    }
+
+    bool operator!=(const file_stamp& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+/// @returns false if the file doesn't exist
+bool get_file_stamp(const path& p, file_stamp& stamp);
+/**
+ * Copies a file into a new directory below temporary_directory() that only the current user can access, the copy keeps the name of from.
+ * Neither the directory nor the copy can be replaced by other users before the copy is used.
+ * @returns the path of the copy or an empty path on failure
+ */
+path make_private_copy(const path& from);
+/// removes a copy created by make_private_copy and its directory
+bool remove_private_copy(const path& copy);
+path temporary_directory();
+
 void forEachFileInDirectory(const path& root, const std::function<void(const path& p)>& func, bool recursive);
 }
 }
@@ -94,6 +125,16 @@ public:
         return name.substr(pos);
     }
 
+    // NOLINTNEXTLINE(readability-identifier-naming)
+    path parent_path() const {
+        const auto pos = m_pathname.find_last_of('/');
+        if (pos == std::string::npos)
+            return {};
+        if (pos == 0)
+            return std::string{"/"};
+        return m_pathname.substr(0, pos);
+    }
+
     path operator/(const std::string& rhs) const {
         return path(this->string() + "/" + rhs);
     }
@@ -110,7 +151,72 @@ bool exists(const path& p);
 bool is_directory(const path& p);
 path canonical(const path& p);
 
+/// identifies the state of a file, changes if the file is modified or replaced
+struct file_stamp final {
+    std::uint64_t device{};
+    std::uint64_t inode{};
+    std::uint64_t size{};
+    std::int64_t  modification_time{};
+
+    bool operator==(const file_stamp& rhs) const {
+        return device == rhs.device && inode == rhs.inode && size == rhs.size && modification_time == rhs.modification_time;
+    }
+
+    bool operator!=(const file_stamp& rhs) const {
+        return !(*this == rhs);
+    }
+};
+
+/// @returns false if the file doesn't exist
+bool get_file_stamp(const path& p, file_stamp& stamp);
+/**
+ * Copies a file into a new directory below temporary_directory() that only the current user can access, the copy keeps the name of from.
+ * Neither the directory nor the copy can be replaced by other users before the copy is used.
+ * @returns the path of the copy or an empty path on failure
+ */
+path make_private_copy(const path& from);
+/// removes a copy created by make_private_copy and its directory
+bool remove_private_copy(const path& copy);
+path temporary_directory();
+
 void forEachFileInDirectory(const path& root, const std::function<void(const filesystem::path& p)>& func, bool recursive);
 }
 }
 #endif
+
+namespace extension_system {
+namespace filesystem {
+/// decides by the name of a directory entry if a file is reported or a directory is entered
+using name_filter = std::function<bool(const char* name, std::size_t length, bool is_directory)>;
+
+/**
+ * Calls func for every file below root that passes filter, directories are entered up to max_depth levels below root.
+ * filter is called before the path of the entry is built and before the entry is stat'ed.
+ */
+void forEachFileInDirectory(const path& root, const name_filter& filter, const std::function<void(const path& p)>& func, std::size_t max_depth);
+
+/**
+ * Resolves the canonical names of files, the canonical name of every directory is only resolved once.
+ * Files that aren't symbolic links only need a single lstat, symbolic links are resolved completely.
+ * Create a new resolver for every scan, directories that are replaced by symbolic links are not noticed.
+ * thread-safe
+ */
+class path_resolver final {
+public:
+    /**
+     * @param real_path canonical name of p
+     * @param stamp state of the file p refers to
+     * @param is_directory true if p refers to a directory
+     * @returns false if p doesn't exist
+     */
+    bool resolve(const path& p, std::string& real_path, file_stamp& stamp, bool& is_directory);
+
+    /// @returns the canonical name of the directory, the name itself if it couldn't be resolved
+    std::string directory(const path& dir);
+
+private:
+    std::mutex                                   m_mutex;
+    std::unordered_map<std::string, std::string> m_directories;
+};
+}
+}
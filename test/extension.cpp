@@ -12,7 +12,8 @@ public:
 // clang-format off
 EXTENSION_SYSTEM_EXTENSION(IExt1, Ext1, "Ext1", 100, "extension 1 for testing purposes",
                            EXTENSION_SYSTEM_DESCRIPTION_ENTRY("Test1", "desc2")
-                           EXTENSION_SYSTEM_DESCRIPTION_ENTRY("Test3", "desc3"))
+                           EXTENSION_SYSTEM_DESCRIPTION_ENTRY("Test3", "desc3")
+                           EXTENSION_SYSTEM_SEMANTIC_VERSION_ENTRY(1, 0, 0))
 // clang-format on
 
 namespace test_namespace {
@@ -25,7 +26,8 @@ public:
 } // namespace test_namespace
 // clang-format off
 EXTENSION_SYSTEM_EXTENSION(IExt1, test_namespace::Ext1_1, "Ext1", 110, "extension 2 for testing purposes",
-                           EXTENSION_SYSTEM_DESCRIPTION_ENTRY("Test1", "desc1"))
+                           EXTENSION_SYSTEM_DESCRIPTION_ENTRY("Test1", "desc1")
+                           EXTENSION_SYSTEM_SEMANTIC_VERSION_ENTRY(1, 1, 0))
 // clang-format on
 
 class Ext2 : public extension_system::IExt2 {
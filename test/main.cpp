@@ -3,11 +3,104 @@
 #define CATCH_CONFIG_MAIN
 #include "catch.hpp"
 
+#include "../examples/example1/Interface.hpp"
 #include "Interfaces.hpp"
+#include <extension_system/DirectoryFilter.hpp>
 #include <extension_system/ExtensionSystem.hpp>
+#include <extension_system/ExtensionPool.hpp>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#ifdef __linux__
+#include <sys/stat.h>
+#endif
 
 using namespace extension_system;
 
+namespace {
+// replaces the file like a package manager does, overwriting a loaded library in place would crash the test
+void replaceFile(const std::string& from, const std::string& to) {
+    const auto tmp = to + ".tmp";
+    {
+        std::ifstream in{from, std::ios::binary};
+        std::ofstream out{tmp, std::ios::binary};
+        out << in.rdbuf();
+    }
+    std::remove(to.c_str());
+    std::rename(tmp.c_str(), to.c_str());
+}
+
+#ifdef __linux__
+// path of a file with the given name that is mapped into the process
+std::string mappedFile(const std::string& name) {
+    std::ifstream maps{"/proc/self/maps"};
+    std::string   line;
+    while (std::getline(maps, line)) {
+        const auto suffix = "/" + name;
+        if (line.size() > suffix.size() && line.compare(line.size() - suffix.size(), suffix.size(), suffix) == 0)
+            return line.substr(line.find('/'));
+    }
+    return {};
+}
+
+// number of inotify watches of all file descriptors of the process
+std::size_t inotifyWatches() {
+    std::size_t count = 0;
+    for (int fd = 0; fd < 1024; ++fd) {
+        std::ifstream info{"/proc/self/fdinfo/" + std::to_string(fd)};
+        std::string   line;
+        while (std::getline(info, line))
+            count += line.compare(0, 11, "inotify wd:") == 0 ? 1 : 0;
+    }
+    return count;
+}
+#endif
+
+// findDescription is private, the descriptions are looked up by their metadata
+ExtensionDescription findExtension(const ExtensionSystem& extension_system,
+                                   const std::string&     interface_name,
+                                   const std::string&     name,
+                                   const std::string&     version) {
+    const auto found = extension_system.extensions({{"interface_name", interface_name}, {"name", name}, {"version", version}});
+    return found.size() == 1 ? found[0] : ExtensionDescription{};
+}
+
+// the version createExtension(name) picks
+ExtensionDescription findHighestVersion(const ExtensionSystem& extension_system,
+                                        const std::string&     interface_name,
+                                        const std::string&     name) {
+    ExtensionDescription result;
+    for (const auto& desc : extension_system.extensions({{"interface_name", interface_name}, {"name", name}}))
+        if (!result.isValid() || result.version() < desc.version())
+            result = desc;
+    return result;
+}
+
+class RecordingTraceSink final : public TraceSink {
+public:
+    void write(const TraceSpan& span) override {
+        std::lock_guard<std::mutex> lock{mutex};
+        names.emplace_back(span.name);
+    }
+
+    std::size_t count(const std::string& name) {
+        std::lock_guard<std::mutex> lock{mutex};
+        return static_cast<std::size_t>(std::count(names.begin(), names.end(), name));
+    }
+
+    std::mutex               mutex;
+    std::vector<std::string> names;
+};
+} // namespace
+
 TEST_CASE("test if the test file can be loaded") {
     std::string     messages;
     ExtensionSystem extension_system;
@@ -121,6 +214,1041 @@ TEST_CASE("load extension by name 2") {
     CHECK(e->test2() == "Hello from Ext2");
 }
 
+TEST_CASE("pooled extensions are recycled") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.searchDirectory(".", true);
+
+    // a moved-from pool would have no state
+    static_assert(!std::is_move_constructible<ExtensionPool<IExt1>>::value && !std::is_move_assignable<ExtensionPool<IExt1>>::value,
+                  "pools are not movable");
+
+    ExtensionPool<IExt1> pool{extension_system, "Ext1", 1, 0};
+    int                  resets = 0;
+    pool.setResetHandler([&](IExt1&) { ++resets; });
+
+    INFO(messages)
+
+    IExt1* first{};
+    {
+        auto e = pool.acquire();
+        REQUIRE(e != nullptr);
+        CHECK(e->test1() == 21);
+        first = e.get();
+    }
+    CHECK(resets == 1);
+    CHECK(pool.idle() == 1);
+
+    {
+        auto e1 = pool.acquireUnique();
+        auto e2 = pool.acquire();
+        REQUIRE(e1 != nullptr);
+        REQUIRE(e2 != nullptr);
+        CHECK(e1.get() == first);
+        CHECK(e2.get() != first);
+    }
+    // the free list is bounded, one of both instances has to be freed
+    CHECK(resets == 3);
+    CHECK(pool.idle() == 1);
+
+    pool.clear();
+    CHECK(pool.idle() == 0);
+}
+
+TEST_CASE("pools free the instances cached by all threads") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.setUnloadPolicy(UnloadPolicy::Immediate);
+    extension_system.searchDirectory(".", true);
+
+    INFO(messages)
+
+    const auto live_instances = [&] {
+        const auto libraries = extension_system.loadedLibraries();
+        return libraries.empty() ? std::size_t{0} : libraries[0].live_instances;
+    };
+
+    {
+        ExtensionPool<IExt1> pool{extension_system, "Ext1", 3, 2};
+        std::thread{[&] { CHECK(pool.acquire() != nullptr); }}.join();
+        CHECK(live_instances() == 1);
+
+        // the thread caches count against max_idle
+        std::vector<std::shared_ptr<IExt1>> instances;
+        for (int i = 0; i < 5; ++i)
+            instances.push_back(pool.acquire());
+        instances.clear();
+        CHECK(live_instances() == 3);
+    }
+
+    // the instance cached by the other thread doesn't keep the library loaded
+    CHECK(extension_system.loadedLibraries().empty());
+}
+
+TEST_CASE("libraries are unloaded according to the unload policy") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.setUnloadPolicy(UnloadPolicy::IdleTimeout, std::chrono::hours{1});
+    extension_system.searchDirectory(".", true);
+
+    INFO(messages)
+
+    CHECK(extension_system.loadedLibraries().empty());
+
+    auto e1 = extension_system.createExtension<IExt1>("Ext1");
+    auto e2 = extension_system.createExtension<IExt2>("Ext2");
+    REQUIRE(e1 != nullptr);
+    REQUIRE(e2 != nullptr);
+
+    auto libraries = extension_system.loadedLibraries();
+    REQUIRE(libraries.size() == 1);
+    CHECK(libraries[0].live_instances == 2);
+    CHECK(libraries[0].pinned);
+    CHECK(libraries[0].registered);
+
+    e1.reset();
+    e2.reset();
+
+    // the idle timeout is not reached
+    CHECK(extension_system.unloadIdleLibraries() == 0);
+    libraries = extension_system.loadedLibraries();
+    REQUIRE(libraries.size() == 1);
+    CHECK(libraries[0].live_instances == 0);
+
+    e1 = extension_system.createExtension<IExt1>("Ext1");
+    REQUIRE(e1 != nullptr);
+
+    extension_system.setUnloadPolicy(UnloadPolicy::Immediate);
+    extension_system.removeDynamicLibrary(libraries[0].filename);
+    libraries = extension_system.loadedLibraries();
+    REQUIRE(libraries.size() == 1);
+    CHECK(libraries[0].live_instances == 1);
+    CHECK_FALSE(libraries[0].pinned);
+    CHECK_FALSE(libraries[0].registered);
+
+    CHECK(e1->test1() == 21);
+    e1.reset();
+    CHECK(extension_system.loadedLibraries().empty());
+}
+
+TEST_CASE("changed libraries are reloaded") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.setEnableHotReload(true);
+
+    // not using DynamicLibrary::fileExtension() prevents that other tests find the file
+    const std::string filename = "hot_reload_test.plugin";
+    const std::string library1 = "libextension_system_test_lib" + DynamicLibrary::fileExtension();
+    const std::string library2 = "libextension_system_example1_extension" + DynamicLibrary::fileExtension();
+
+    replaceFile(library1, filename);
+    REQUIRE(extension_system.addDynamicLibrary(filename) == 3);
+
+    INFO(messages)
+
+    auto e1 = extension_system.createExtension<IExt1>("Ext1");
+    REQUIRE(e1 != nullptr);
+    const auto old_generation = extension_system.extensions<IExt1>()[0].generation();
+
+    // unchanged files are not reloaded
+    CHECK(extension_system.reloadChangedLibraries() == 0);
+
+    replaceFile(library2, filename);
+    CHECK(extension_system.addDynamicLibrary(filename) == 1);
+    CHECK(extension_system.extensions<IExt1>().empty());
+
+    // the old instance keeps the old library alive
+    CHECK(e1->test1() == 21);
+    CHECK(extension_system.loadedLibraries().size() == 1);
+
+    replaceFile(library1, filename);
+    CHECK(extension_system.reloadChangedLibraries() == 1);
+    const auto e = extension_system.extensions<IExt1>();
+    REQUIRE(e.size() == 2);
+    CHECK(e[0].generation() > old_generation);
+
+    auto e2 = extension_system.createExtension<IExt1>("Ext1", 100);
+    REQUIRE(e2 != nullptr);
+    CHECK(e2->test1() == 42);
+    CHECK(extension_system.loadedLibraries().size() == 2);
+
+    std::remove(filename.c_str());
+    CHECK(extension_system.reloadChangedLibraries() == 1);
+    CHECK(extension_system.extensions().empty());
+    CHECK(e2->test1() == 42);
+
+#ifdef __linux__
+    // the copy was created in a directory only accessible by the current user and is removed with the library
+    const auto copy = mappedFile(filename);
+    REQUIRE(copy.find("/extension_system_") != std::string::npos);
+    const auto  copy_dir = copy.substr(0, copy.rfind('/'));
+    struct stat sb { };
+    REQUIRE(stat(copy_dir.c_str(), &sb) == 0);
+    CHECK((sb.st_mode & 0777U) == 0700U);
+
+    e2.reset();
+    CHECK(stat(copy.c_str(), &sb) != 0);
+    CHECK(stat(copy_dir.c_str(), &sb) != 0);
+#endif
+}
+
+TEST_CASE("changed libraries are reloaded without hot reload") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    REQUIRE(!extension_system.getEnableHotReload());
+
+    const std::string filename = "reload_without_hot_reload_test.plugin";
+    replaceFile("libextension_system_test_lib" + DynamicLibrary::fileExtension(), filename);
+    REQUIRE(extension_system.addDynamicLibrary(filename) == 3);
+
+    INFO(messages)
+
+    auto e1 = extension_system.createExtension<IExt1>("Ext1", 100);
+    REQUIRE(e1 != nullptr);
+
+    // the dynamic loader still knows the old library by the path, the new code has to be loaded from a copy
+    replaceFile("libextension_system_example1_extension" + DynamicLibrary::fileExtension(), filename);
+    CHECK(extension_system.reloadChangedLibraries() == 1);
+    auto e2 = extension_system.createExtension<Interface1>("Example1Extension");
+    REQUIRE(e2 != nullptr);
+    CHECK(e2->test1() == "Hello from Extension1");
+    CHECK(e1->test1() == 42);
+
+    std::remove(filename.c_str());
+}
+
+#if defined(__linux__) && defined(__GLIBC__)
+TEST_CASE("load extension into an isolated link namespace") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.setLinkNamespace(LinkNamespace::Isolated);
+    extension_system.setUnloadPolicy(UnloadPolicy::Immediate);
+    extension_system.searchDirectory(".", true);
+
+    INFO(messages)
+
+    auto e1 = extension_system.createExtension<IExt1>("Ext1", 100);
+    auto e2 = extension_system.createExtension<IExt2>("Ext2");
+    REQUIRE(e1 != nullptr);
+    REQUIRE(e2 != nullptr); // don't call test2, the returned string would be allocated by a different C++ runtime
+    CHECK(e1->test1() == 42);
+    CHECK(extension_system.loadedLibraries().size() == 1);
+    CHECK(messages.find("no isolated link namespace") == std::string::npos);
+}
+#endif
+
+#ifndef _WIN32
+#include <climits>
+#include <sys/stat.h>
+#include <unistd.h>
+
+TEST_CASE("changes in watched directories are applied") {
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.setEnableDirectoryWatch(true);
+
+    // use a directory outside of the build directory, otherwise the other tests would find the copied library
+    const char*       tmp = std::getenv("TMPDIR");
+    const std::string dir = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_watch_test";
+    const std::string filename = dir + "/watched" + DynamicLibrary::fileExtension();
+    const std::string ignored  = dir + "/ignored.txt";
+    std::remove(filename.c_str());
+    std::remove(ignored.c_str());
+    (void)mkdir(dir.c_str(), 0755);
+
+    extension_system.searchDirectory(dir, true);
+
+    INFO(messages)
+
+    CHECK(extension_system.processDirectoryChanges() == 0);
+
+    replaceFile("libextension_system_test_lib" + DynamicLibrary::fileExtension(), filename);
+    replaceFile("libextension_system_test_lib" + DynamicLibrary::fileExtension(), ignored);
+    CHECK(extension_system.processDirectoryChanges(std::chrono::milliseconds{10}) == 1);
+    CHECK(extension_system.extensions().size() == 3);
+    auto e1 = extension_system.createExtension<IExt1>("Ext1", 100);
+    REQUIRE(e1 != nullptr);
+
+    // modified files are reloaded without hot reload, the new code is used and not the library already loaded from the path
+    REQUIRE(!extension_system.getEnableHotReload());
+    replaceFile("libextension_system_example1_extension" + DynamicLibrary::fileExtension(), filename);
+    CHECK(extension_system.processDirectoryChanges() == 1);
+    CHECK(extension_system.extensions().size() == 1);
+    auto e2 = extension_system.createExtension<Interface1>("Example1Extension");
+    REQUIRE(e2 != nullptr);
+    CHECK(e2->test1() == "Hello from Extension1");
+    CHECK(e1->test1() == 42);
+
+    std::remove(filename.c_str());
+    CHECK(extension_system.processDirectoryChanges() == 1);
+    CHECK(extension_system.extensions().empty());
+
+    std::remove(ignored.c_str());
+    (void)rmdir(dir.c_str());
+}
+
+TEST_CASE("files that aren't shared libraries are skipped") {
+    std::string error;
+    CHECK(DynamicLibrary::checkFileFormat("libextension_system_test_lib" + DynamicLibrary::fileExtension(), error));
+    CHECK_FALSE(DynamicLibrary::checkFileFormat("dummy_test_extension", error));
+    CHECK_FALSE(error.empty());
+
+    const char*       tmp       = std::getenv("TMPDIR");
+    const std::string dir       = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_format_test";
+    const std::string raw       = dir + "/raw" + DynamicLibrary::fileExtension();
+    const std::string script    = dir + "/script" + DynamicLibrary::fileExtension();
+    const std::string truncated = dir + "/truncated" + DynamicLibrary::fileExtension();
+    (void)mkdir(dir.c_str(), 0755);
+    replaceFile("dummy_test_extension", raw);
+    std::ofstream{script} << "/* GNU ld script */\nINPUT(libc.so.6)\n";
+    std::ofstream{truncated} << "\x7f" "ELF";
+
+    CHECK_FALSE(DynamicLibrary::checkFileFormat(truncated, error));
+    CHECK(error == "file is too small");
+    CHECK_FALSE(DynamicLibrary::checkFileFormat(dir, error));
+    CHECK(error == "not a regular file");
+
+    ExtensionSystem extension_system;
+    extension_system.setVerifyCompiler(false);
+    extension_system.searchDirectory(dir);
+    CHECK(extension_system.extensions().empty());
+
+    extension_system.setCheckFileFormat(false);
+    extension_system.searchDirectory(dir);
+    CHECK(extension_system.extensions().size() == 1);
+
+    std::remove(raw.c_str());
+    std::remove(script.c_str());
+    std::remove(truncated.c_str());
+    (void)rmdir(dir.c_str());
+}
+
+TEST_CASE("libraries read on worker threads are added in the order they were found") {
+    const char*       tmp = std::getenv("TMPDIR");
+    const std::string dir = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_threads_test";
+    (void)mkdir(dir.c_str(), 0755);
+    std::vector<std::string> files;
+    for (int i = 0; i < 12; ++i) {
+        files.push_back(dir + "/lib" + std::to_string(i) + DynamicLibrary::fileExtension());
+        replaceFile("libextension_system_example" + std::to_string(i % 2 + 1) + "_extension" + DynamicLibrary::fileExtension(), files.back());
+    }
+
+    const auto scan = [&](std::size_t threads) {
+        ExtensionSystem extension_system;
+        extension_system.setMessageHandler([](const std::string&) {});
+        extension_system.setScanThreads(threads);
+        extension_system.searchDirectory(dir);
+        extension_system.searchDirectory(dir); // already known libraries are not read again
+
+        std::vector<std::string> result;
+        for (const auto& e : extension_system.extensions())
+            result.push_back(e.library_filename() + ":" + e.interface_name() + ":" + e.name());
+        return result;
+    };
+
+    const auto serial = scan(1);
+    CHECK(serial.size() == 12);
+    CHECK(scan(3) == serial);
+    CHECK(scan(64) == serial);
+
+    for (const auto& file : files)
+        std::remove(file.c_str());
+    (void)rmdir(dir.c_str());
+}
+
+TEST_CASE("libraries in nested directories are found") {
+    const char*       tmp     = std::getenv("TMPDIR");
+    const std::string dir     = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_walk_test";
+    const std::string nested  = dir + "/a/b";
+    const std::string library = nested + "/lib" + DynamicLibrary::fileExtension();
+    const std::string link    = dir + "/link";
+    const std::string loop    = nested + "/loop";
+    (void)mkdir(dir.c_str(), 0755);
+    (void)mkdir((dir + "/a").c_str(), 0755);
+    (void)mkdir(nested.c_str(), 0755);
+    (void)mkdir((dir + "/empty").c_str(), 0755);
+    replaceFile("libextension_system_example1_extension" + DynamicLibrary::fileExtension(), library);
+    (void)symlink(nested.c_str(), link.c_str());
+    (void)symlink(dir.c_str(), loop.c_str());
+
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+
+    extension_system.searchDirectory(dir, false);
+    CHECK(extension_system.extensions().empty());
+
+    extension_system.searchDirectory(dir, true);
+    INFO(messages)
+    REQUIRE(extension_system.extensions().size() == 1);
+
+    // the directory of the first found name is a symbolic link, the library is still registered by its real name
+    char real_library[PATH_MAX]{};
+    REQUIRE(realpath(library.c_str(), real_library) != nullptr);
+    CHECK(extension_system.extensions()[0].library_filename() == real_library);
+
+    // the library is reachable through a/b, the symbolic link and the loop, but only read once
+    const auto first = messages.find("check file ");
+    REQUIRE(first != std::string::npos);
+    CHECK(messages.find("check file ", first + 1) == std::string::npos);
+
+    std::remove(loop.c_str());
+    std::remove(link.c_str());
+    std::remove(library.c_str());
+    (void)rmdir(nested.c_str());
+    (void)rmdir((dir + "/a").c_str());
+    (void)rmdir((dir + "/empty").c_str());
+    (void)rmdir(dir.c_str());
+}
+
+TEST_CASE("directory filters are applied before files are opened") {
+    const char*       tmp     = std::getenv("TMPDIR");
+    const std::string dir     = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_filter_test";
+    const std::string ext     = DynamicLibrary::fileExtension();
+    const std::string example = "libextension_system_example1_extension" + ext;
+    const std::vector<std::string> dirs{dir, dir + "/sub", dir + "/sub/deeper", dir + "/excluded"};
+    const std::vector<std::string> files{dir + "/libext_a" + ext,
+                                         dir + "/skip_me" + ext,
+                                         dir + "/sub/libext_b" + ext,
+                                         dir + "/sub/deeper/libext_c" + ext,
+                                         dir + "/excluded/libext_d" + ext};
+    for (const auto& d : dirs)
+        (void)mkdir(d.c_str(), 0755);
+    for (const auto& f : files)
+        replaceFile(example, f);
+
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setEnableDebugOutput(true);
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    extension_system.searchDirectory(dir, DirectoryFilter{}.include("libext_*").include("skip*").exclude("excluded").excludeRegex("skip_.*").maxDepth(1));
+
+    std::vector<std::string> found;
+    for (const auto& e : extension_system.extensions())
+        found.push_back(e.library_filename().substr(e.library_filename().find_last_of('/') + 1));
+    std::sort(found.begin(), found.end());
+    CHECK(found == (std::vector<std::string>{"libext_a" + ext, "libext_b" + ext}));
+
+    // rejected files are never read
+    INFO(messages)
+    CHECK(messages.find("skip_me") == std::string::npos);
+    CHECK(messages.find("libext_c") == std::string::npos);
+    CHECK(messages.find("libext_d") == std::string::npos);
+
+    for (const auto& f : files)
+        std::remove(f.c_str());
+    for (auto iter = dirs.rbegin(); iter != dirs.rend(); ++iter)
+        (void)rmdir(iter->c_str());
+}
+
+#ifdef __linux__
+TEST_CASE("watched directories are limited by the directory filter") {
+    const char*                    tmp = std::getenv("TMPDIR");
+    const std::string              dir = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_filtered_watch_test";
+    const std::string              ext = DynamicLibrary::fileExtension();
+    const std::vector<std::string> dirs{dir, dir + "/sub", dir + "/sub/deeper", dir + "/sub/deeper/deepest", dir + "/excluded"};
+    for (const auto& d : dirs)
+        (void)mkdir(d.c_str(), 0755);
+
+    const auto      watches_before = inotifyWatches();
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([](const std::string&) {});
+    extension_system.setEnableDirectoryWatch(true);
+    extension_system.searchDirectory(dir, DirectoryFilter{}.exclude("excluded").maxDepth(1));
+
+    // only dir and sub are watched, neither the excluded directory nor the directories below the maximum depth
+    CHECK(inotifyWatches() - watches_before == 2);
+
+    // new directories follow the same rules
+    const std::vector<std::string> new_dirs{dir + "/new", dir + "/sub/new", dir + "/excluded/new"};
+    for (const auto& d : new_dirs)
+        (void)mkdir(d.c_str(), 0755);
+    CHECK(extension_system.processDirectoryChanges() == 0);
+    CHECK(inotifyWatches() - watches_before == 3);
+
+    const std::string library = dir + "/new/libext" + ext;
+    replaceFile("libextension_system_example1_extension" + ext, library);
+    CHECK(extension_system.processDirectoryChanges() == 1);
+    CHECK(extension_system.extensions().size() == 1);
+
+    std::remove(library.c_str());
+    for (auto iter = new_dirs.rbegin(); iter != new_dirs.rend(); ++iter)
+        (void)rmdir(iter->c_str());
+    for (auto iter = dirs.rbegin(); iter != dirs.rend(); ++iter)
+        (void)rmdir(iter->c_str());
+}
+#endif
+#endif
+
+TEST_CASE("directory filter patterns") {
+    const auto file = [](const DirectoryFilter& filter, const std::string& name) { return filter.matchesFile(name.c_str(), name.length()); };
+
+    DirectoryFilter defaults;
+    CHECK(file(defaults, "libfoo" + DynamicLibrary::fileExtension()));
+    CHECK_FALSE(file(defaults, "libfoo.txt"));
+    CHECK(defaults.maxDepth() == 0);
+
+    DirectoryFilter globs;
+    globs.include("lib?oo.*").include("[a-c]*[!0-9].so").include("\\*x").exclude("*.bak");
+    CHECK(file(globs, "libfoo.so"));
+    CHECK(file(globs, "libzoo.dll"));
+    CHECK_FALSE(file(globs, "libfooo.so"));
+    CHECK(file(globs, "beta.so"));
+    CHECK_FALSE(file(globs, "beta1.so"));
+    CHECK_FALSE(file(globs, "delta.so"));
+    CHECK(file(globs, "*x"));
+    CHECK_FALSE(file(globs, "ax"));
+    CHECK_FALSE(file(globs, "libfoo.bak"));
+    CHECK_FALSE(file(globs, "libfoo" + DynamicLibrary::fileExtension() + ".bak"));
+
+    DirectoryFilter expressions;
+    expressions.includeRegex("plugin_[0-9]+\\.so").excludeRegex(".*_old.*").maxDepth(2);
+    CHECK(file(expressions, "plugin_42.so"));
+    CHECK_FALSE(file(expressions, "plugin_.so"));
+    CHECK_FALSE(file(expressions, "xplugin_42.so"));
+    CHECK_FALSE(file(expressions, "plugin_42.so_old"));
+    CHECK(expressions.matchesPath("/a/b/plugin_1.so"));
+    CHECK_FALSE(expressions.matchesPath("/a/b/c/plugin_1.so"));
+    CHECK_FALSE(expressions.matchesPath("/a/b_old/plugin_1.so"));
+    CHECK_FALSE(expressions.matchesPath("/a/b/"));
+}
+
+TEST_CASE("libraries are probed without adding them") {
+    const auto library = "libextension_system_test_lib" + DynamicLibrary::fileExtension();
+    const auto names   = [](std::vector<ExtensionDescription> descs) {
+        std::vector<std::string> result;
+        for (const auto& d : descs)
+            result.push_back(d.interface_name() + ":" + d.name() + ":" + std::to_string(d.version()));
+        std::sort(result.begin(), result.end());
+        return result;
+    };
+
+    ExtensionSystem extension_system;
+    const auto      probed = extension_system.probeLibrary(library);
+    CHECK(probed.size() == 3);
+    CHECK(extension_system.extensions().empty());
+    for (const auto& d : probed)
+        CHECK(d.generation() == 0);
+
+    // the read-only data of the library contains the same descriptions as the whole file
+    REQUIRE(extension_system.addDynamicLibrary(library) == 3);
+    CHECK(names(probed) == names(extension_system.extensions()));
+
+    // added libraries are not read again
+    const auto cached = extension_system.probeLibrary(library);
+    REQUIRE(cached.size() == 3);
+    CHECK(cached[0].generation() != 0);
+
+    extension_system.setMessageHandler([](const std::string&) {});
+    CHECK(extension_system.probeLibrary("does_not_exist").empty());
+    CHECK(extension_system.probeLibrary("dummy_test_extension").empty());
+}
+
+TEST_CASE("latency histogram percentiles") {
+    LatencyHistogram histogram;
+    CHECK(histogram.percentile(50).count() == 0);
+
+    for (int i = 1; i <= 1000; ++i)
+        histogram.record(std::chrono::microseconds{i});
+    histogram.record(std::chrono::nanoseconds{3});
+
+    CHECK(histogram.count() == 1001);
+    CHECK(histogram.max() == std::chrono::microseconds{1000});
+    CHECK(histogram.sum() == std::chrono::nanoseconds{500500003});
+    CHECK(histogram.percentile(0).count() == 3);
+    const auto median = std::chrono::duration_cast<std::chrono::microseconds>(histogram.percentile(50)).count();
+    CHECK(median >= 500);
+    CHECK(median <= 500 * 9 / 8);
+    CHECK(histogram.percentile(100) == std::chrono::microseconds{1000});
+
+    std::uint64_t buckets = 0;
+    histogram.forEachBucket([&](std::chrono::nanoseconds, std::uint64_t count) { buckets += count; });
+    CHECK(buckets == 1001);
+
+    histogram.reset();
+    CHECK(histogram.count() == 0);
+}
+
+TEST_CASE("latencies are recorded per library and extension") {
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([](const std::string&) {});
+    extension_system.searchDirectory(".", true);
+
+    auto e1 = extension_system.createExtension<IExt1>("Ext1", 100);
+    auto e2 = extension_system.createExtension<IExt1>("Ext1", 100);
+    REQUIRE(e1 != nullptr);
+    e1.reset();
+    e2.reset();
+
+    const auto library = findExtension(extension_system, "IExt1", "Ext1", "100").library_filename();
+
+    bool found_library   = false;
+    bool found_extension = false;
+    for (const auto& l : extension_system.latencies()) {
+        if (l.library_filename != library)
+            continue;
+        if (l.interface_name.empty()) {
+            found_library = true;
+            CHECK(l.histograms->scan.count() == 1);
+            CHECK(l.histograms->dlopen.count() == 1);
+            CHECK(l.histograms->construct.count() == 2);
+            CHECK(l.histograms->destroy.count() == 2);
+        } else if (l.name == "Ext1" && l.version == 100) {
+            found_extension = true;
+            CHECK(l.interface_name == "IExt1");
+            CHECK(l.histograms->scan.count() == 0);
+            CHECK(l.histograms->dlopen.count() == 1);
+            CHECK(l.histograms->construct.count() == 2);
+            CHECK(l.histograms->destroy.count() == 2);
+        }
+    }
+    CHECK(found_library);
+    CHECK(found_extension);
+
+    const auto metrics = extension_system.latencyMetrics();
+    CHECK(metrics.find("# TYPE extension_system_library_scan_seconds histogram") != std::string::npos);
+    CHECK(metrics.find("extension_system_library_dlopen_seconds_count{library=\"" + library + "\"} 1") != std::string::npos);
+    CHECK(metrics.find("extension_system_extension_construct_seconds_bucket{library=\"" + library
+                       + "\",interface=\"IExt1\",name=\"Ext1\",version=\"100\",le=\"+Inf\"} 2")
+          != std::string::npos);
+
+    extension_system.resetLatencies();
+    for (const auto& l : extension_system.latencies())
+        CHECK(l.histograms->construct.count() == 0);
+}
+
+TEST_CASE("live and peak instances are counted per extension") {
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([](const std::string&) {});
+    extension_system.searchDirectory(".", true);
+
+    const auto usage = [&](ExtensionVersion version) {
+        for (const auto& u : extension_system.extensionUsage())
+            if (u.interface_name == "IExt1" && u.name == "Ext1" && u.version == version)
+                return u;
+        return ExtensionUsage{};
+    };
+
+    CHECK(extension_system.extensionUsage().empty());
+
+    auto e1 = extension_system.createExtension<IExt1>("Ext1", 100);
+    auto e2 = extension_system.createExtension<IExt1>("Ext1", 100);
+    auto e3 = extension_system.createExtension<IExt1>("Ext1", 110);
+    REQUIRE(e1 != nullptr);
+    REQUIRE(e3 != nullptr);
+    CHECK(usage(100).live_instances == 2);
+    CHECK(usage(110).live_instances == 1);
+
+    e1.reset();
+    e2.reset();
+    auto e4 = extension_system.createExtension<IExt1>("Ext1", 100);
+    CHECK(usage(100).live_instances == 1);
+    CHECK(usage(100).peak_instances == 2);
+    CHECK(usage(100).created == 3);
+    CHECK(usage(100).library_filename == findExtension(extension_system, "IExt1", "Ext1", "100").library_filename());
+
+    extension_system.resetPeakInstances();
+    CHECK(usage(100).peak_instances == 1);
+
+    e3.reset();
+    e4.reset();
+    CHECK(usage(100).live_instances == 0);
+    CHECK(usage(110).live_instances == 0);
+    CHECK(usage(110).peak_instances == 1);
+}
+
+TEST_CASE("descriptions spanning scan chunks are found") {
+    std::string messages;
+    for (const std::size_t chunk_size : {1, 7, 64, 4096}) {
+        ExtensionSystem extension_system;
+        extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+        extension_system.setScanChunkSize(chunk_size);
+        extension_system.searchDirectory(".", true);
+
+        INFO(messages)
+        CHECK(extension_system.extensions().size() == 5);
+        CHECK(findExtension(extension_system, "IExt1", "Ext1", "100").description() == "extension 1 for testing purposes");
+
+        extension_system.setVerifyCompiler(false);
+        CHECK(extension_system.addDynamicLibrary("dummy_test_extension") == 1);
+    }
+    CHECK(messages.empty());
+}
+
+TEST_CASE("metadata with a wrong checksum is validated entry by entry") {
+    const auto library = "libextension_system_test_lib" + DynamicLibrary::fileExtension();
+    std::string content;
+    {
+        std::ifstream in{library, std::ios::binary};
+        content.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    }
+
+    ExtensionSystem extension_system;
+    REQUIRE(extension_system.addDynamicLibrary(library) == 3);
+    CHECK(findExtension(extension_system, "IExt1", "Ext1", "100").get("Test3") == "desc3");
+
+    // modified metadata doesn't match its checksum anymore, it is still accepted if the entries are valid,
+    // the entry is modified in all extensions that have it, their order in the library depends on the build
+    const std::string entry{"Test3\x05\0\0\0desc3", 14};
+    auto              pos = content.find(entry);
+    if (pos == std::string::npos)
+        return; // built without compile time metadata (C++11)
+    for (; pos != std::string::npos; pos = content.find(entry, pos + entry.size()))
+        content[pos + 13] = '4';
+    const std::string modified = "modified_metadata_test";
+    std::ofstream{modified, std::ios::binary} << content;
+
+    ExtensionSystem modified_system;
+    CHECK(modified_system.addDynamicLibrary(modified) == 3);
+    CHECK(findExtension(modified_system, "IExt1", "Ext1", "100").get("Test3") == "desc4");
+    std::remove(modified.c_str());
+}
+
+TEST_CASE("binary metadata is decoded without tokenizing") {
+    const auto  library = "libextension_system_test_lib" + DynamicLibrary::fileExtension();
+    std::string content;
+    {
+        std::ifstream in{library, std::ios::binary};
+        content.assign(std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{});
+    }
+
+    const std::string start = std::string{"EXTENSION_SYSTEM_METADATA_DESCRIPTION_"} + "START=2" + '\0' + "ESMD";
+    const auto        pos   = content.find(start);
+    if (pos == std::string::npos)
+        return; // built without compile time metadata (C++11)
+
+    // the header contains the version and the hash of the interface name of the first extension in the library
+    const auto number = [&](std::size_t offset, std::size_t bytes) {
+        std::uint64_t value = 0;
+        for (std::size_t i = bytes; i > 0; --i)
+            value = value << 8U | static_cast<unsigned char>(content[pos + start.size() + offset + i - 1]);
+        return value;
+    };
+    CHECK(number(0, 2) == EXTENSION_SYSTEM_EXTENSION_API_VERSION_BINARY);
+    const auto version = number(8, 4);
+    CHECK((version == 100 || version == 110 || version == 120));
+
+    // a length pointing behind the end tag is rejected, the other extensions are still found
+    const auto length = content.find(std::string{"\x04\0name", 6}, pos);
+    REQUIRE(length != std::string::npos);
+    content[length + 6] = '\x7f';
+    content[length + 9] = '\x7f';
+    const std::string modified = "modified_binary_metadata_test";
+    std::ofstream{modified, std::ios::binary} << content;
+
+    std::string     messages;
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    CHECK(extension_system.addDynamicLibrary(modified) == 2);
+    CHECK(messages.find("truncated") != std::string::npos);
+    std::remove(modified.c_str());
+}
+
+TEST_CASE("stray, interleaved and unterminated tags are reported") {
+    const std::string base  = "EXTENSION_SYSTEM_METADATA_DESCRIPTION_";
+    const std::string start = base + "START=1" + '\0';
+    const std::string end   = base + "END";
+    const auto        desc  = [&](const std::string& name) {
+        return std::string{"interface_name=I"} + '\0' + "name=" + name + '\0' + "version=1" + '\0' + "entry_point=f" + '\0';
+    };
+    const std::string file = "malformed_tags_test";
+    std::ofstream{file, std::ios::binary} << end << base << "DECOY" << start << desc("a") << end << start << start << desc("b") << end
+                                          << start << desc("c") << end << start << desc("d");
+
+    for (const std::size_t chunk_size : {1, 7, 4096}) {
+        std::string     messages;
+        ExtensionSystem extension_system;
+        extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+        extension_system.setVerifyCompiler(false);
+        extension_system.setScanChunkSize(chunk_size);
+
+        INFO(messages)
+        CHECK(extension_system.addDynamicLibrary(file) == 2);
+        CHECK(findHighestVersion(extension_system, "I", "a").isValid());
+        CHECK(findHighestVersion(extension_system, "I", "c").isValid());
+        CHECK(messages.find("found a start tag before the expected end tag") != std::string::npos);
+        CHECK(messages.find("end tag was missing") != std::string::npos);
+    }
+
+    std::remove(file.c_str());
+}
+
+TEST_CASE("oversized sections don't hide the following descriptions") {
+    const std::string base  = "EXTENSION_SYSTEM_METADATA_DESCRIPTION_";
+    const std::string start = base + "START=1" + '\0';
+    const std::string desc  = start + "interface_name=I" + '\0' + "name=a" + '\0' + "version=1" + '\0' + "entry_point=f" + '\0' + base + "END";
+    const std::string file  = "oversized_section_test";
+    // a stray start tag, more than the maximal description size (1 MiB) of filler and a valid description
+    std::ofstream{file, std::ios::binary} << start << std::string(1024 * 1024 + 1, 'x') << desc;
+
+    for (const std::size_t chunk_size : {4096, 4 * 1024 * 1024}) {
+        std::string     messages;
+        ExtensionSystem extension_system;
+        extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+        extension_system.setVerifyCompiler(false);
+        extension_system.setScanChunkSize(chunk_size);
+
+        INFO(messages)
+        CHECK(extension_system.addDynamicLibrary(file) == 1);
+        CHECK(findHighestVersion(extension_system, "I", "a").isValid());
+        CHECK(messages.find("end tag was missing") != std::string::npos);
+    }
+
+    std::remove(file.c_str());
+}
+
+TEST_CASE("version ranges") {
+    const auto v = [](const char* str) {
+        SemanticVersion version{};
+        REQUIRE(SemanticVersion::parse(str, std::strlen(str), version));
+        return version;
+    };
+    const auto contains = [&](const char* range, const char* version) {
+        const VersionRange r{range};
+        INFO(range << " " << version)
+        REQUIRE(r.isValid());
+        return r.contains(v(version));
+    };
+
+    SemanticVersion version{};
+    CHECK(!SemanticVersion::parse("1.2", 3, version));
+    CHECK(!SemanticVersion::parse("1.2.x", 5, version));
+    CHECK(!SemanticVersion::parse("1.2.4294967296", 14, version));
+    CHECK(v("1.2.4294967295").toString() == "1.2.4294967295");
+
+    CHECK(contains("", "0.0.0"));
+    CHECK(contains("*", "7.3.1"));
+    CHECK(contains(">=1.2 <2", "1.2.0"));
+    CHECK(contains(">=1.2 <2", "1.99.99"));
+    CHECK_FALSE(contains(">=1.2 <2", "1.1.9"));
+    CHECK_FALSE(contains(">=1.2 <2", "2.0.0"));
+    CHECK(contains(">= 1.2 < 2", "1.5.0"));
+    CHECK(contains(">1.2", "1.3.0"));
+    CHECK_FALSE(contains(">1.2", "1.2.9"));
+    CHECK(contains("<=1.2", "1.2.9"));
+    CHECK_FALSE(contains("<=1.2", "1.3.0"));
+    CHECK(contains("1.x", "1.9.0"));
+    CHECK_FALSE(contains("1.x", "2.0.0"));
+    CHECK(contains("=1.2.3", "1.2.3"));
+    CHECK_FALSE(contains("1.2.3", "1.2.4"));
+    CHECK(contains("^1.2.3", "1.9.0"));
+    CHECK_FALSE(contains("^1.2.3", "2.0.0"));
+    CHECK_FALSE(contains("^0.2.3", "0.3.0"));
+    CHECK_FALSE(contains("^0.0.3", "0.0.4"));
+    CHECK(contains("~1.2.3", "1.2.9"));
+    CHECK_FALSE(contains("~1.2.3", "1.3.0"));
+    CHECK(contains("~1", "1.9.0"));
+    CHECK(contains("1.2 - 1.4", "1.4.7"));
+    CHECK_FALSE(contains("1.2 - 1.4", "1.5.0"));
+    CHECK(contains("<1 || ^3.1", "3.2.0"));
+    CHECK_FALSE(contains("<1 || ^3.1", "2.0.0"));
+    CHECK_FALSE(contains("<=1.2.4294967295", "1.3.0"));
+    CHECK(contains("<=4294967295", "4294967295.1.0"));
+
+    CHECK(VersionRange{">2 <1"}.intervals().empty());
+    for (const char* invalid : {"abc", ">=", "1.2.3.4", "1.x.3", "1 - ", ">=1.2-beta", "1.2.3 - 1.4 - 2"})
+        CHECK_FALSE(VersionRange{invalid}.isValid());
+}
+
+TEST_CASE("extensions are resolved by semantic version ranges") {
+    ExtensionSystem extension_system;
+    std::string     messages;
+    extension_system.setMessageHandler([&](const std::string& msg) { messages += msg + "\n"; });
+    REQUIRE(extension_system.addDynamicLibrary("libextension_system_test_lib" + DynamicLibrary::fileExtension()) == 3);
+
+    CHECK(findHighestVersion(extension_system, "IExt1", "Ext1").semanticVersion() == SemanticVersion{1, 1, 0});
+    CHECK(findHighestVersion(extension_system, "extension_system::IExt2", "Ext2").semanticVersion() == SemanticVersion{100, 0, 0});
+
+    auto e = extension_system.createExtension<IExt1>("Ext1", "^1.0");
+    REQUIRE(e != nullptr);
+    CHECK(e->test1() == 21);
+    e = extension_system.createExtension<IExt1>("Ext1", ">=1 <1.1");
+    REQUIRE(e != nullptr);
+    CHECK(e->test1() == 42);
+    CHECK(extension_system.createExtension<IExt1>("Ext1", "2.x") == nullptr);
+    CHECK(messages.empty());
+    CHECK(extension_system.createExtension<IExt1>("Ext1", ">=1 <<2") == nullptr);
+    CHECK(messages.find("invalid version range >=1 <<2") != std::string::npos);
+
+    // many versions side by side, spread over two copies of the test library that all create Ext1 100
+    const auto        entry_point = findExtension(extension_system, "IExt1", "Ext1", "100").get("entry_point");
+    const std::string base        = "EXTENSION_SYSTEM_METADATA_DESCRIPTION_";
+    const auto        desc        = [&](const std::string& name, unsigned version, const std::string& semantic_version) {
+        return base + "START=1" + '\0' + "interface_name=IExt1" + '\0' + "name=" + name + '\0' + "version=" + std::to_string(version) + '\0'
+               + (semantic_version.empty() ? "" : "semantic_version=" + semantic_version + '\0') + "entry_point=" + entry_point + '\0'
+               + base + "END";
+    };
+    const std::string files[] = {"semantic_versions_test_a", "semantic_versions_test_b"};
+    {
+        std::ofstream a{files[0], std::ios::binary};
+        std::ofstream b{files[1], std::ios::binary};
+        for (auto* out : {&a, &b})
+            *out << std::ifstream{"libextension_system_test_lib" + DynamicLibrary::fileExtension(), std::ios::binary}.rdbuf();
+        unsigned version = 0;
+        for (unsigned major = 0; major < 3; ++major)
+            for (unsigned minor = 0; minor < 10; ++minor)
+                for (unsigned patch = 0; patch < 5; ++patch, ++version)
+                    (version % 2 == 0 ? a : b)
+                        << desc("e", version, std::to_string(major) + "." + std::to_string(minor) + "." + std::to_string(patch));
+
+        // an old build without semantic version (90.0.0) and a newer version with a lower semantic version than version 110
+        b << desc("m", 90, "") << desc("m", 110, "1.1.0") << desc("m", 120, "1.0.5");
+    }
+    extension_system.setVerifyCompiler(false);
+    CHECK(extension_system.addDynamicLibrary(files[0]) == 78);
+    CHECK(extension_system.addDynamicLibrary(files[1]) == 81);
+
+    // the semantic version of the created instance, version = major * 50 + minor * 5 + patch
+    const auto created = [&](const std::shared_ptr<IExt1>& e) -> std::string {
+        if (e == nullptr)
+            return "none";
+        for (const auto& u : extension_system.extensionUsage())
+            if (u.name == "e" && u.live_instances == 1)
+                return std::to_string(u.version / 50) + "." + std::to_string(u.version / 5 % 10) + "." + std::to_string(u.version % 5);
+        return {};
+    };
+    const auto resolve = [&](const char* range) { return created(extension_system.createExtension<IExt1>("e", range)); };
+    CHECK(resolve("*") == "2.9.4");
+    CHECK(resolve(">=1.2 <2") == "1.9.4");
+    CHECK(resolve("~1.2") == "1.2.4");
+    CHECK(resolve("^0.3.1") == "0.3.4");
+    CHECK(resolve("<1.2.3 || 0.5 - 0.6") == "1.2.2");
+    CHECK(resolve(">2.9.4 || <0.0.0") == "none");
+    CHECK(created(extension_system.createExtension<IExt1>("e")) == "2.9.4");
+    CHECK(created(extension_system.createExtension<IExt1>("e", 61)) == "1.2.1");
+
+    // without a range the highest version is created, independent of the semantic versions
+    const auto created_version = [&](const std::shared_ptr<IExt1>& e) -> ExtensionVersion {
+        for (const auto& u : extension_system.extensionUsage())
+            if (e != nullptr && u.name == "m" && u.live_instances == 1)
+                return u.version;
+        return 0;
+    };
+    CHECK(created_version(extension_system.createExtension<IExt1>("m")) == 120);
+    CHECK(created_version(extension_system.createExtension<IExt1>("m", "*")) == 90);
+    CHECK(created_version(extension_system.createExtension<IExt1>("m", "^1")) == 110);
+
+    // versions of removed libraries are not found anymore
+    extension_system.removeDynamicLibrary(files[0]);
+    CHECK(resolve("~1.2") == "1.2.3");
+    CHECK(resolve("1.2.4") == "none");
+
+    for (const auto& file : files)
+        std::remove(file.c_str());
+}
+
+TEST_CASE("memory usage of the registry") {
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([](const std::string&) {});
+    CHECK(extension_system.memoryUsage().libraries.empty());
+
+    extension_system.searchDirectory(".", true);
+    const auto usage = extension_system.memoryUsage();
+    REQUIRE(usage.libraries.size() == 3); // test library and the two example extensions
+
+    std::size_t total = usage.indexes;
+    for (const auto& l : usage.libraries) {
+        CHECK(l.descriptions >= sizeof(ExtensionDescription));
+        CHECK(l.description_maps > 0);
+        CHECK(l.metadata_strings > 0); // e.g. library_filename is an absolute path
+        total += l.total();
+    }
+    CHECK(usage.indexes > 0);
+    CHECK(usage.total() == total);
+
+    const auto library = findHighestVersion(extension_system, "IExt1", "Ext1").library_filename();
+    extension_system.removeDynamicLibrary(library);
+    CHECK(extension_system.memoryUsage().libraries.size() == 2);
+    CHECK(extension_system.memoryUsage().total() < usage.total());
+}
+
+TEST_CASE("lookups follow added and removed libraries") {
+    ExtensionSystem extension_system;
+    extension_system.setMessageHandler([](const std::string&) {});
+    extension_system.searchDirectory(".", true);
+
+    const auto library = findHighestVersion(extension_system, "IExt1", "Ext1").library_filename();
+    REQUIRE(!library.empty());
+    CHECK(findHighestVersion(extension_system, "IExt1", "Ext1").version() == 110);
+    CHECK(extension_system.extensions<IExt1>().size() == 2);
+    CHECK(extension_system.extensions({{"library_filename", library}}).size() == 3);
+    CHECK(extension_system.extensions({{"name", "Ext1"}, {"name", "Ext2"}}).size() == 3);
+    CHECK(extension_system.extensions({{"name", "unknown"}}).empty());
+
+    const auto count = extension_system.extensions().size();
+    extension_system.removeDynamicLibrary(library);
+    CHECK(extension_system.extensions().size() == count - 3);
+    CHECK(!findHighestVersion(extension_system, "IExt1", "Ext1").isValid());
+    CHECK(!findExtension(extension_system, "IExt1", "Ext1", "100").isValid());
+    CHECK(extension_system.extensions<IExt1>().empty());
+    CHECK(extension_system.extensions({{"library_filename", library}}).empty());
+
+    CHECK(extension_system.addDynamicLibrary(library) == 3);
+    CHECK(findExtension(extension_system, "IExt1", "Ext1", "100").isValid());
+    CHECK(extension_system.extensions().size() == count);
+}
+
+TEST_CASE("spans are written to the trace sink") {
+    auto sink = std::make_shared<RecordingTraceSink>();
+    setTraceSink(sink);
+    {
+        ExtensionSystem extension_system;
+        extension_system.setMessageHandler([](const std::string&) {});
+        extension_system.searchDirectory(".", true);
+        auto e = extension_system.createExtension<IExt1>("Ext1");
+        REQUIRE(e != nullptr);
+    }
+    setTraceSink(nullptr);
+
+#ifdef EXTENSION_SYSTEM_ENABLE_TRACING
+    CHECK(sink->count("searchDirectory") == 1);
+    CHECK(sink->count("addDynamicLibrary") >= 1);
+    CHECK(sink->count("search") == sink->count("addDynamicLibrary"));
+    CHECK(sink->count("parse") >= 3);
+    CHECK(sink->count("lookup") == 1);
+    CHECK(sink->count("createExtension") == 1);
+    CHECK(sink->count("dlopen") == 1);
+    CHECK(sink->count("dlsym") == 1);
+    CHECK(sink->count("construct") == 1);
+    CHECK(sink->count("destroyExtension") == 1);
+#else
+    CHECK(sink->names.empty());
+#endif
+
+    const char*       tmp      = std::getenv("TMPDIR");
+    const std::string filename = std::string{tmp != nullptr ? tmp : "/tmp"} + "/extension_system_trace.json";
+    {
+        ChromeTraceSink chrome{filename};
+        REQUIRE(chrome.isOpen());
+        const std::string detail = "lib\"name";
+        const auto        now    = std::chrono::steady_clock::now();
+        chrome.write(TraceSpan{"dlopen", detail, now, now + std::chrono::milliseconds{1}, std::this_thread::get_id()});
+    }
+
+    std::ifstream     in{filename};
+    const std::string json{std::istreambuf_iterator<char>{in}, std::istreambuf_iterator<char>{}};
+    std::remove(filename.c_str());
+    CHECK(json.find(R"({"traceEvents":[)") == 0);
+    CHECK(json.find(R"("name":"dlopen")") != std::string::npos);
+    CHECK(json.find(R"("ph":"X")") != std::string::npos);
+    CHECK(json.find(R"("dur":1000,)") != std::string::npos);
+    CHECK(json.find(R"("detail":"lib\"name")") != std::string::npos);
+    CHECK(json.rfind("]") != std::string::npos);
+}
+
 #if 0
 TEST_CASE("check if filter work as expected")
 {